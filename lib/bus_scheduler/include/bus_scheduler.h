@@ -0,0 +1,74 @@
+/*
+Measurements of the sensors on one bus lined up to shared slots
+
+The sensors do not run their own update intervals. A task wakes up at the start of each slot and starts the measurement
+of every sensor that is due, one after another, so the conversions run together and the bus and the MCU are busy in one
+burst per slot instead of at the drifting phases of the sensors. The interval of a sensor is rounded to whole slots and
+the task sleeps over the slots without a measurement due.
+
+The event handler of a sensor reports the end of its measurement, the time from the start of the slot to the end of its
+last measurement is the busy time of the bus. A measurement that did not end before the next slot is counted as missed.
+*/
+
+#ifndef _BUS_SCHEDULER_H
+#define _BUS_SCHEDULER_H
+
+#include <twr.h>
+
+#ifndef BUS_SCHEDULER_SENSORS_MAX
+#define BUS_SCHEDULER_SENSORS_MAX 8
+#endif
+
+// Function starting the measurement of the sensor, it returns false when the sensor cannot measure now
+typedef bool (*bus_scheduler_measure_t)(void *sensor);
+
+typedef struct
+{
+    const char *name;
+    bus_scheduler_measure_t measure;
+    void *sensor;
+
+    // Number of slots between the measurements and the slot of the next one
+    uint32_t slots;
+    uint32_t next_slot;
+
+    bool measuring;
+} bus_scheduler_sensor_t;
+
+typedef struct
+{
+    uint32_t slots;
+    uint32_t measurements;
+    uint32_t missed;
+
+    // Sum of the busy times and the longest one
+    twr_tick_t busy_time;
+    twr_tick_t busy_time_max;
+} bus_scheduler_stats_t;
+
+typedef struct
+{
+    twr_tick_t slot_interval;
+    twr_scheduler_task_id_t task_id;
+
+    bus_scheduler_sensor_t sensors[BUS_SCHEDULER_SENSORS_MAX];
+    int count;
+
+    // Number of the last started slot, its start and the measurements not ended in it yet
+    uint32_t slot;
+    twr_tick_t slot_tick;
+    int measuring;
+
+    // Next slot with a measurement due
+    uint32_t planned_slot;
+
+    bus_scheduler_stats_t stats;
+} bus_scheduler_t;
+
+void bus_scheduler_init(bus_scheduler_t *self, twr_tick_t slot_interval);
+int bus_scheduler_add(bus_scheduler_t *self, const char *name, bus_scheduler_measure_t measure, void *sensor, twr_tick_t interval);
+void bus_scheduler_set_interval(bus_scheduler_t *self, int index, twr_tick_t interval);
+void bus_scheduler_done(bus_scheduler_t *self, int index);
+const bus_scheduler_stats_t *bus_scheduler_get_stats(const bus_scheduler_t *self);
+
+#endif // _BUS_SCHEDULER_H
@@ -0,0 +1,177 @@
+/*
+Measurements of the sensors on one bus lined up to shared slots
+*/
+
+#include <bus_scheduler.h>
+#include <string.h>
+
+static void bus_scheduler_task(void *param);
+
+void bus_scheduler_init(bus_scheduler_t *self, twr_tick_t slot_interval)
+{
+    memset(self, 0, sizeof(*self));
+
+    self->slot_interval = slot_interval;
+    self->planned_slot = 1;
+    self->task_id = twr_scheduler_register(bus_scheduler_task, self, 0);
+}
+
+/*
+This function will return the interval in whole slots, at least one
+*/
+static uint32_t bus_scheduler_get_slots(bus_scheduler_t *self, twr_tick_t interval)
+{
+    uint32_t slots = (interval + self->slot_interval / 2) / self->slot_interval;
+
+    return slots > 0 ? slots : 1;
+}
+
+/*
+This function will add the sensor measured in the next slot and return its index, or -1 when there is no room for it
+*/
+int bus_scheduler_add(bus_scheduler_t *self, const char *name, bus_scheduler_measure_t measure, void *sensor, twr_tick_t interval)
+{
+    if (self->count == BUS_SCHEDULER_SENSORS_MAX)
+    {
+        twr_log_warning("Bus scheduler full");
+
+        return -1;
+    }
+
+    bus_scheduler_sensor_t *item = &self->sensors[self->count];
+
+    item->name = name;
+    item->measure = measure;
+    item->sensor = sensor;
+    item->slots = bus_scheduler_get_slots(self, interval);
+    item->next_slot = self->planned_slot;
+    item->measuring = false;
+
+    return self->count++;
+}
+
+/*
+This function will change the interval of the sensor, a shorter one applies from the last started slot and may wake
+the task up sooner
+*/
+void bus_scheduler_set_interval(bus_scheduler_t *self, int index, twr_tick_t interval)
+{
+    if (index < 0 || index >= self->count)
+    {
+        return;
+    }
+
+    bus_scheduler_sensor_t *item = &self->sensors[index];
+
+    item->slots = bus_scheduler_get_slots(self, interval);
+
+    if (self->slot + item->slots < item->next_slot)
+    {
+        item->next_slot = self->slot + item->slots;
+    }
+
+    if (item->next_slot < self->planned_slot)
+    {
+        self->planned_slot = item->next_slot;
+
+        twr_scheduler_plan_absolute(self->task_id, self->slot_tick + (self->planned_slot - self->slot) * self->slot_interval);
+    }
+}
+
+/*
+This function will take the end of the measurement of the sensor, from its event handler on an update or an error
+*/
+void bus_scheduler_done(bus_scheduler_t *self, int index)
+{
+    if (index < 0 || index >= self->count || !self->sensors[index].measuring)
+    {
+        return;
+    }
+
+    self->sensors[index].measuring = false;
+
+    if (--self->measuring > 0)
+    {
+        return;
+    }
+
+    twr_tick_t busy_time = twr_tick_get() - self->slot_tick;
+
+    self->stats.busy_time += busy_time;
+
+    if (busy_time > self->stats.busy_time_max)
+    {
+        self->stats.busy_time_max = busy_time;
+    }
+
+    twr_log_debug("$BUS: busy %lu ms, %lu ms in %lu slots, %lu measurements, %lu missed", (unsigned long) busy_time,
+                  (unsigned long) self->stats.busy_time, (unsigned long) self->stats.slots,
+                  (unsigned long) self->stats.measurements, (unsigned long) self->stats.missed);
+}
+
+/*
+Task starting the measurements due in the slot, it sleeps over the slots without any
+*/
+static void bus_scheduler_task(void *param)
+{
+    bus_scheduler_t *self = param;
+
+    self->slot = self->planned_slot;
+
+    for (int i = 0; i < self->count; i++)
+    {
+        bus_scheduler_sensor_t *item = &self->sensors[i];
+
+        if (item->measuring)
+        {
+            item->measuring = false;
+            self->stats.missed++;
+
+            twr_log_warning("Bus measurement missed: %s", item->name);
+        }
+    }
+
+    self->measuring = 0;
+    self->slot_tick = twr_tick_get();
+
+    for (int i = 0; i < self->count; i++)
+    {
+        bus_scheduler_sensor_t *item = &self->sensors[i];
+
+        if (item->next_slot > self->slot)
+        {
+            continue;
+        }
+
+        item->next_slot = self->slot + item->slots;
+
+        if (item->measure(item->sensor))
+        {
+            item->measuring = true;
+            self->measuring++;
+            self->stats.measurements++;
+        }
+    }
+
+    if (self->measuring > 0)
+    {
+        self->stats.slots++;
+    }
+
+    self->planned_slot = self->slot + 1;
+
+    for (int i = 0; i < self->count; i++)
+    {
+        if (i == 0 || self->sensors[i].next_slot < self->planned_slot)
+        {
+            self->planned_slot = self->sensors[i].next_slot;
+        }
+    }
+
+    twr_scheduler_plan_current_absolute(self->slot_tick + (self->planned_slot - self->slot) * self->slot_interval);
+}
+
+const bus_scheduler_stats_t *bus_scheduler_get_stats(const bus_scheduler_t *self)
+{
+    return &self->stats;
+}
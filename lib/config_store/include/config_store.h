@@ -0,0 +1,71 @@
+/*
+Typed key/value configuration stored in the EEPROM
+
+The firmware describes its keys in a table: the type, the size and the default value of each. Every key gets its own
+region in the EEPROM in the order of the table, the value followed by its CRC16, behind a header with the layout
+version and a checksum of the table. A changed table, or a different version, is a different layout, and the store is
+formatted with the defaults.
+
+Setting a key compares the new region with the EEPROM and writes only the bytes that differ, so setting the same value
+costs no write and changing a short string does not rewrite the whole region. Reading is a copy from the EEPROM and a
+CRC check, a region with a wrong CRC reads as the default.
+*/
+
+#ifndef _CONFIG_STORE_H
+#define _CONFIG_STORE_H
+
+#include <twr.h>
+
+// EEPROM space of the header and of a key of the given size
+#define CONFIG_STORE_HEADER_SIZE 8
+#define CONFIG_STORE_REGION_SIZE(size) ((size) + 2)
+
+typedef enum
+{
+    CONFIG_STORE_TYPE_INT32 = 0,
+    CONFIG_STORE_TYPE_FLOAT = 1,
+
+    // Zero terminated text, the size includes the terminator
+    CONFIG_STORE_TYPE_STRING = 2,
+    CONFIG_STORE_TYPE_BLOB = 3
+} config_store_type_t;
+
+typedef struct
+{
+    config_store_type_t type;
+    uint16_t size;
+
+    // Value of the key before it is set, size bytes like a char array of the size for a text, or NULL for zeros
+    const void *default_value;
+} config_store_key_t;
+
+typedef struct
+{
+    uint32_t bytes_written;
+    uint32_t writes;
+} config_store_stats_t;
+
+typedef struct
+{
+    uint32_t address;
+    uint16_t version;
+    const config_store_key_t *keys;
+    size_t count;
+    bool formatted;
+    config_store_stats_t stats;
+} config_store_t;
+
+bool config_store_init(config_store_t *self, uint32_t address, uint16_t version, const config_store_key_t *keys, size_t count);
+bool config_store_format(config_store_t *self);
+size_t config_store_get_size(const config_store_t *self);
+bool config_store_get(config_store_t *self, size_t key, void *value);
+bool config_store_set(config_store_t *self, size_t key, const void *value);
+int32_t config_store_get_int32(config_store_t *self, size_t key);
+bool config_store_set_int32(config_store_t *self, size_t key, int32_t value);
+float config_store_get_float(config_store_t *self, size_t key);
+bool config_store_set_float(config_store_t *self, size_t key, float value);
+bool config_store_get_string(config_store_t *self, size_t key, char *text, size_t size);
+bool config_store_set_string(config_store_t *self, size_t key, const char *text);
+const config_store_stats_t *config_store_get_stats(const config_store_t *self);
+
+#endif // _CONFIG_STORE_H
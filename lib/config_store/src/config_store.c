@@ -0,0 +1,387 @@
+/*
+Typed key/value configuration stored in the EEPROM
+*/
+
+#include <config_store.h>
+#include <string.h>
+
+#define CONFIG_STORE_MAGIC 0x53464743
+
+// Bytes compared with the EEPROM at a time
+#define CONFIG_STORE_CHUNK_SIZE 16
+
+static uint16_t config_store_crc_update(uint16_t crc, const uint8_t *data, size_t length)
+{
+    while (length-- > 0)
+    {
+        crc ^= (uint16_t) *data++ << 8;
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+/*
+This function will return the checksum of the types and sizes of the keys, it tells a changed table from the stored one
+*/
+static uint16_t config_store_layout_crc(const config_store_t *self)
+{
+    uint16_t crc = 0xffff;
+
+    for (size_t i = 0; i < self->count; i++)
+    {
+        uint8_t key[3] = { self->keys[i].type, self->keys[i].size, self->keys[i].size >> 8 };
+
+        crc = config_store_crc_update(crc, key, sizeof(key));
+    }
+
+    return crc;
+}
+
+static uint32_t config_store_key_address(const config_store_t *self, size_t key)
+{
+    uint32_t address = self->address + CONFIG_STORE_HEADER_SIZE;
+
+    for (size_t i = 0; i < key; i++)
+    {
+        address += CONFIG_STORE_REGION_SIZE(self->keys[i].size);
+    }
+
+    return address;
+}
+
+/*
+This function will return the CRC16 of the value of the key as it is in the EEPROM
+*/
+static uint16_t config_store_value_crc(const config_store_t *self, size_t key)
+{
+    uint32_t address = config_store_key_address(self, key);
+    uint8_t chunk[CONFIG_STORE_CHUNK_SIZE];
+    uint16_t crc = 0xffff;
+
+    for (size_t offset = 0; offset < self->keys[key].size; offset += sizeof(chunk))
+    {
+        size_t length = self->keys[key].size - offset < sizeof(chunk) ? self->keys[key].size - offset : sizeof(chunk);
+
+        twr_eeprom_read(address + offset, chunk, length);
+        crc = config_store_crc_update(crc, chunk, length);
+    }
+
+    return crc;
+}
+
+/*
+This function will write the data to the EEPROM, only the runs of bytes that differ from the EEPROM are written
+*/
+static bool config_store_write(config_store_t *self, uint32_t address, const void *data, size_t length)
+{
+    const uint8_t *bytes = data;
+    uint8_t chunk[CONFIG_STORE_CHUNK_SIZE];
+
+    for (size_t offset = 0; offset < length; offset += sizeof(chunk))
+    {
+        size_t chunk_length = length - offset < sizeof(chunk) ? length - offset : sizeof(chunk);
+
+        if (!twr_eeprom_read(address + offset, chunk, chunk_length))
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < chunk_length; i++)
+        {
+            if (chunk[i] == bytes[offset + i])
+            {
+                continue;
+            }
+
+            size_t start = i;
+
+            while (i + 1 < chunk_length && chunk[i + 1] != bytes[offset + i + 1])
+            {
+                i++;
+            }
+
+            if (!twr_eeprom_write(address + offset + start, &bytes[offset + start], i - start + 1))
+            {
+                return false;
+            }
+
+            self->stats.writes++;
+            self->stats.bytes_written += i - start + 1;
+        }
+    }
+
+    return true;
+}
+
+/*
+This function will write the first bytes of the value of the key and then the CRC16 of its whole value
+
+The rest of the value stays as it is in the EEPROM, like the bytes behind the terminator of a shorter text
+*/
+static bool config_store_write_value(config_store_t *self, size_t key, const void *value, size_t length)
+{
+    uint32_t address = config_store_key_address(self, key);
+    uint32_t bytes_written = self->stats.bytes_written;
+
+    if (!config_store_write(self, address, value, length))
+    {
+        return false;
+    }
+
+    uint16_t crc = config_store_value_crc(self, key);
+
+    if (!config_store_write(self, address + self->keys[key].size, &crc, sizeof(crc)))
+    {
+        return false;
+    }
+
+    twr_log_debug("$CONFIG: key %d, %d B written", (int) key, (int) (self->stats.bytes_written - bytes_written));
+
+    return true;
+}
+
+/*
+This function will find the layout in the EEPROM and return true if its version and keys match the table
+
+Without the layout all the keys read as their defaults, the first key set or config_store_format writes the layout. A firmware
+that changes the layout may read what it needs from the old one before that.
+*/
+bool config_store_init(config_store_t *self, uint32_t address, uint16_t version, const config_store_key_t *keys, size_t count)
+{
+    uint32_t header[2];
+
+    memset(self, 0, sizeof(*self));
+
+    self->address = address;
+    self->version = version;
+    self->keys = keys;
+    self->count = count;
+
+    if (address + config_store_get_size(self) > twr_eeprom_get_size() || !twr_eeprom_read(address, header, sizeof(header)))
+    {
+        return false;
+    }
+
+    self->formatted = header[0] == CONFIG_STORE_MAGIC && header[1] == ((uint32_t) config_store_layout_crc(self) << 16 | version);
+
+    return self->formatted;
+}
+
+/*
+This function will write the defaults of all the keys and then the header of the layout
+
+A reset before the header is written leaves the store without the layout, so it is formatted again at the next boot
+*/
+bool config_store_format(config_store_t *self)
+{
+    uint32_t header[2] = { CONFIG_STORE_MAGIC, (uint32_t) config_store_layout_crc(self) << 16 | self->version };
+    uint8_t zeros[CONFIG_STORE_CHUNK_SIZE] = { 0 };
+
+    if (self->address + config_store_get_size(self) > twr_eeprom_get_size())
+    {
+        return false;
+    }
+
+    for (size_t key = 0; key < self->count; key++)
+    {
+        uint32_t address = config_store_key_address(self, key);
+
+        if (self->keys[key].default_value != NULL)
+        {
+            if (!config_store_write(self, address, self->keys[key].default_value, self->keys[key].size))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            for (size_t offset = 0; offset < self->keys[key].size; offset += sizeof(zeros))
+            {
+                size_t length = self->keys[key].size - offset < sizeof(zeros) ? self->keys[key].size - offset : sizeof(zeros);
+
+                if (!config_store_write(self, address + offset, zeros, length))
+                {
+                    return false;
+                }
+            }
+        }
+
+        uint16_t crc = config_store_value_crc(self, key);
+
+        if (!config_store_write(self, address + self->keys[key].size, &crc, sizeof(crc)))
+        {
+            return false;
+        }
+    }
+
+    if (!config_store_write(self, self->address, header, sizeof(header)))
+    {
+        return false;
+    }
+
+    self->formatted = true;
+
+    twr_log_debug("$CONFIG: layout %u formatted", self->version);
+
+    return true;
+}
+
+/*
+This function will return the EEPROM space of the header and all the keys
+*/
+size_t config_store_get_size(const config_store_t *self)
+{
+    return config_store_key_address(self, self->count) - self->address;
+}
+
+/*
+This function will copy the value of the key, it returns false and copies the default when the key is not stored or its CRC is wrong
+*/
+bool config_store_get(config_store_t *self, size_t key, void *value)
+{
+    const config_store_key_t *definition = &self->keys[key];
+    uint32_t address = config_store_key_address(self, key);
+    uint16_t crc;
+
+    if (self->formatted && twr_eeprom_read(address + definition->size, &crc, sizeof(crc)) && crc == config_store_value_crc(self, key))
+    {
+        return twr_eeprom_read(address, value, definition->size);
+    }
+
+    if (definition->default_value != NULL)
+    {
+        memcpy(value, definition->default_value, definition->size);
+    }
+    else
+    {
+        memset(value, 0, definition->size);
+    }
+
+    return false;
+}
+
+/*
+This function will store the value of the key, the store is formatted first when it does not have the layout yet
+*/
+bool config_store_set(config_store_t *self, size_t key, const void *value)
+{
+    if (!self->formatted && !config_store_format(self))
+    {
+        return false;
+    }
+
+    return config_store_write_value(self, key, value, self->keys[key].size);
+}
+
+int32_t config_store_get_int32(config_store_t *self, size_t key)
+{
+    int32_t value = 0;
+
+    if (self->keys[key].type == CONFIG_STORE_TYPE_INT32 && self->keys[key].size == sizeof(value))
+    {
+        config_store_get(self, key, &value);
+    }
+
+    return value;
+}
+
+bool config_store_set_int32(config_store_t *self, size_t key, int32_t value)
+{
+    if (self->keys[key].type != CONFIG_STORE_TYPE_INT32 || self->keys[key].size != sizeof(value))
+    {
+        return false;
+    }
+
+    return config_store_set(self, key, &value);
+}
+
+float config_store_get_float(config_store_t *self, size_t key)
+{
+    float value = 0.0f;
+
+    if (self->keys[key].type == CONFIG_STORE_TYPE_FLOAT && self->keys[key].size == sizeof(value))
+    {
+        config_store_get(self, key, &value);
+    }
+
+    return value;
+}
+
+bool config_store_set_float(config_store_t *self, size_t key, float value)
+{
+    if (self->keys[key].type != CONFIG_STORE_TYPE_FLOAT || self->keys[key].size != sizeof(value))
+    {
+        return false;
+    }
+
+    return config_store_set(self, key, &value);
+}
+
+/*
+This function will copy the text of the key into the buffer of the given size, a longer text is cut
+*/
+bool config_store_get_string(config_store_t *self, size_t key, char *text, size_t size)
+{
+    const config_store_key_t *definition = &self->keys[key];
+    uint32_t address = config_store_key_address(self, key);
+    uint16_t crc;
+    bool valid = false;
+
+    if (definition->type != CONFIG_STORE_TYPE_STRING || size == 0)
+    {
+        return false;
+    }
+
+    size_t length = size < definition->size ? size : definition->size;
+
+    if (self->formatted && twr_eeprom_read(address + definition->size, &crc, sizeof(crc)) && crc == config_store_value_crc(self, key))
+    {
+        valid = twr_eeprom_read(address, text, length);
+    }
+
+    if (!valid)
+    {
+        if (definition->default_value != NULL)
+        {
+            memcpy(text, definition->default_value, length);
+        }
+        else
+        {
+            memset(text, 0, length);
+        }
+    }
+
+    text[length - 1] = '\0';
+
+    return valid;
+}
+
+/*
+This function will store the text and its terminator, a text that does not fit the key is refused
+*/
+bool config_store_set_string(config_store_t *self, size_t key, const char *text)
+{
+    size_t length = strlen(text) + 1;
+
+    if (self->keys[key].type != CONFIG_STORE_TYPE_STRING || length > self->keys[key].size)
+    {
+        return false;
+    }
+
+    if (!self->formatted && !config_store_format(self))
+    {
+        return false;
+    }
+
+    return config_store_write_value(self, key, text, length);
+}
+
+const config_store_stats_t *config_store_get_stats(const config_store_t *self)
+{
+    return &self->stats;
+}
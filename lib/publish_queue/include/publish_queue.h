@@ -0,0 +1,73 @@
+/*
+Queue of the values published by a node in compound packets
+
+A value set to the queue waits for the window that started with the first waiting value, a newer value of the same
+topic replaces it, and at the end of the window all waiting values are sent in one packet. Values that do not fit in
+one packet are split into more packets. The heartbeat of the node sends all known values together once per heartbeat
+interval, so the values do not need heartbeats of their own.
+
+The packet is a radio buffer of the PUBLISH_QUEUE_FORMAT byte followed by three bytes per value, the topic ID from the
+dictionary below and the value as a little endian int16 in the units of the topic, that is multiplied by ten to the
+power of its decimals. Topics marked unsigned send an uint16 instead. Values out of the range are limited to it. The
+"Compound packet" node of the Node-RED flows keeps the same dictionary and publishes the values back on their topics.
+*/
+
+#ifndef _PUBLISH_QUEUE_H
+#define _PUBLISH_QUEUE_H
+
+#include <twr.h>
+
+// First byte of the packet, a new packet layout gets a new number
+#define PUBLISH_QUEUE_FORMAT 1
+
+// Largest packet, the radio buffer keeps room for its header
+#ifndef PUBLISH_QUEUE_PACKET_SIZE
+#define PUBLISH_QUEUE_PACKET_SIZE 49
+#endif
+
+// Topic IDs agreed with the gateway, an ID is never reused for another topic
+typedef enum
+{
+    PUBLISH_TOPIC_TEMPERATURE = 1,           // thermometer/0:0/temperature, 0.01 °C
+    PUBLISH_TOPIC_TEMPERATURE_ALTERNATE = 2, // thermometer/0:1/temperature, 0.01 °C
+    PUBLISH_TOPIC_HUMIDITY = 3,              // hygrometer/0:0/relative-humidity, 0.1 %
+    PUBLISH_TOPIC_ILLUMINANCE = 4,           // lux-meter/0:0/illuminance, 10 lx
+    PUBLISH_TOPIC_PRESSURE = 5,              // barometer/0:0/pressure, 10 Pa
+    PUBLISH_TOPIC_CO2 = 6,                   // co2-meter/-/concentration, 1 ppm
+    PUBLISH_TOPIC_TVOC = 7,                  // voc-lp-sensor/0:0/tvoc, 1 ppb, unsigned
+    PUBLISH_TOPIC_VOLTAGE = 8,               // battery/-/voltage, 0.01 V
+    PUBLISH_TOPIC_PERCENTAGE = 9,            // voltage/percentage, 1 %
+    PUBLISH_TOPIC_COUNT
+} publish_topic_t;
+
+typedef struct
+{
+    uint32_t values;
+    uint32_t packets;
+    uint32_t bytes;
+    uint32_t heartbeats;
+
+    // Waiting values replaced by a newer one before they were sent
+    uint32_t merged;
+} publish_queue_stats_t;
+
+typedef struct
+{
+    twr_tick_t window;
+    twr_tick_t heartbeat_interval;
+    twr_scheduler_task_id_t window_task_id;
+    twr_scheduler_task_id_t heartbeat_task_id;
+
+    // Last value of each topic and the bit masks of the known and the waiting values
+    float values[PUBLISH_TOPIC_COUNT];
+    uint32_t known;
+    uint32_t waiting;
+
+    publish_queue_stats_t stats;
+} publish_queue_t;
+
+void publish_queue_init(publish_queue_t *self, twr_tick_t window, twr_tick_t heartbeat_interval);
+void publish_queue_set(publish_queue_t *self, publish_topic_t topic, float value);
+const publish_queue_stats_t *publish_queue_get_stats(const publish_queue_t *self);
+
+#endif // _PUBLISH_QUEUE_H
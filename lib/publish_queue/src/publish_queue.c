@@ -0,0 +1,201 @@
+/*
+Queue of the values published by a node in compound packets
+*/
+
+#include <publish_queue.h>
+#include <string.h>
+#include <math.h>
+
+// Decimals of the topics in the packet and whether the value is unsigned, the same as in the dictionary of the gateway
+static const struct
+{
+    int8_t decimals;
+    bool is_unsigned;
+} publish_topic_formats[PUBLISH_TOPIC_COUNT] =
+{
+    [PUBLISH_TOPIC_TEMPERATURE] = { 2, false },
+    [PUBLISH_TOPIC_TEMPERATURE_ALTERNATE] = { 2, false },
+    [PUBLISH_TOPIC_HUMIDITY] = { 1, false },
+    [PUBLISH_TOPIC_ILLUMINANCE] = { -1, false },
+    [PUBLISH_TOPIC_PRESSURE] = { -1, false },
+    [PUBLISH_TOPIC_CO2] = { 0, false },
+    [PUBLISH_TOPIC_TVOC] = { 0, true },
+    [PUBLISH_TOPIC_VOLTAGE] = { 2, false },
+    [PUBLISH_TOPIC_PERCENTAGE] = { 0, false },
+};
+
+static void publish_queue_window_task(void *param);
+static void publish_queue_heartbeat_task(void *param);
+
+void publish_queue_init(publish_queue_t *self, twr_tick_t window, twr_tick_t heartbeat_interval)
+{
+    memset(self, 0, sizeof(*self));
+
+    self->window = window;
+    self->heartbeat_interval = heartbeat_interval;
+
+    self->window_task_id = twr_scheduler_register(publish_queue_window_task, self, TWR_TICK_INFINITY);
+    self->heartbeat_task_id = twr_scheduler_register(publish_queue_heartbeat_task, self, heartbeat_interval);
+}
+
+/*
+This function will keep the value of the topic until the end of the window, the first waiting value starts the window
+*/
+void publish_queue_set(publish_queue_t *self, publish_topic_t topic, float value)
+{
+    if (topic <= 0 || topic >= PUBLISH_TOPIC_COUNT || isnan(value))
+    {
+        return;
+    }
+
+    if (self->waiting == 0)
+    {
+        twr_scheduler_plan_relative(self->window_task_id, self->window);
+    }
+    else if (self->waiting & (1UL << topic))
+    {
+        self->stats.merged++;
+    }
+
+    self->values[topic] = value;
+    self->known |= 1UL << topic;
+    self->waiting |= 1UL << topic;
+}
+
+/*
+This function will return the 16 bits of the value in the units of the topic, limited to the int16 range or to the
+uint16 range for an unsigned topic
+*/
+static uint16_t publish_queue_encode(publish_topic_t topic, float value)
+{
+    int decimals = publish_topic_formats[topic].decimals;
+
+    for (; decimals > 0; decimals--)
+    {
+        value *= 10;
+    }
+
+    for (; decimals < 0; decimals++)
+    {
+        value /= 10;
+    }
+
+    value = roundf(value);
+
+    if (publish_topic_formats[topic].is_unsigned)
+    {
+        if (value > UINT16_MAX)
+        {
+            return UINT16_MAX;
+        }
+
+        if (value < 0)
+        {
+            return 0;
+        }
+
+        return (uint16_t) value;
+    }
+
+    if (value > INT16_MAX)
+    {
+        return INT16_MAX;
+    }
+
+    if (value < INT16_MIN)
+    {
+        return (uint16_t) INT16_MIN;
+    }
+
+    return (uint16_t) (int16_t) value;
+}
+
+/*
+This function will send the packet and start the next one
+*/
+static void publish_queue_flush(publish_queue_t *self, uint8_t *packet, size_t *length)
+{
+    if (*length > 1)
+    {
+        twr_radio_pub_buffer(packet, *length);
+
+        self->stats.packets++;
+        self->stats.bytes += *length;
+    }
+
+    *length = 1;
+}
+
+/*
+This function will send the values of the topics in the mask, in as few packets as they fit in
+*/
+static void publish_queue_send(publish_queue_t *self, uint32_t mask)
+{
+    uint8_t packet[PUBLISH_QUEUE_PACKET_SIZE] = { PUBLISH_QUEUE_FORMAT };
+    size_t length = 1;
+
+    for (int topic = 1; topic < PUBLISH_TOPIC_COUNT; topic++)
+    {
+        if (!(mask & (1UL << topic)))
+        {
+            continue;
+        }
+
+        if (length + 3 > sizeof(packet))
+        {
+            publish_queue_flush(self, packet, &length);
+        }
+
+        uint16_t value = publish_queue_encode(topic, self->values[topic]);
+
+        packet[length++] = topic;
+        packet[length++] = value & 0xff;
+        packet[length++] = value >> 8;
+
+        self->stats.values++;
+    }
+
+    publish_queue_flush(self, packet, &length);
+
+    self->waiting &= ~mask;
+
+    twr_log_debug("$PUBLISH: %lu values in %lu packets of %lu B, %lu merged, %lu heartbeats", (unsigned long) self->stats.values,
+                  (unsigned long) self->stats.packets, (unsigned long) self->stats.bytes, (unsigned long) self->stats.merged,
+                  (unsigned long) self->stats.heartbeats);
+}
+
+/*
+Task sending the values waiting at the end of the window
+*/
+static void publish_queue_window_task(void *param)
+{
+    publish_queue_t *self = param;
+
+    // The heartbeat may have sent them already
+    if (self->waiting != 0)
+    {
+        publish_queue_send(self, self->waiting);
+    }
+}
+
+/*
+Task sending all known values once per heartbeat interval, the values waiting for the window go with them
+*/
+static void publish_queue_heartbeat_task(void *param)
+{
+    publish_queue_t *self = param;
+
+    if (self->known != 0)
+    {
+        self->stats.heartbeats++;
+
+        publish_queue_send(self, self->known);
+    }
+
+    twr_scheduler_plan_current_relative(self->heartbeat_interval);
+}
+
+const publish_queue_stats_t *publish_queue_get_stats(const publish_queue_t *self)
+{
+    return &self->stats;
+}
@@ -0,0 +1,74 @@
+/*
+Report on change of a measured value
+
+Each channel is a value published over the radio, like the temperature of a tag. A reading is published when it differs
+from the last published value by the deadband, or when the longest interval without a publication elapsed. A change is
+not published sooner than the shortest interval after the last publication, the next reading after it decides.
+
+The deadband adapts to the noise of the sensor. The noise is estimated from the second difference of the consecutive
+readings, so a steady rise or fall of the value is not taken for noise, and the deadband is REPORT_NOISE_FACTOR times the
+noise, limited by the deadband range of the channel. A quiet sensor publishes every change above the smallest deadband,
+a noisy one does not publish its noise.
+*/
+
+#ifndef _REPORT_H
+#define _REPORT_H
+
+#include <twr.h>
+
+// Multiple of the noise used as the deadband
+#ifndef REPORT_NOISE_FACTOR
+#define REPORT_NOISE_FACTOR 4.0f
+#endif
+
+// Number of readings the noise estimate is averaged over
+#ifndef REPORT_NOISE_WEIGHT
+#define REPORT_NOISE_WEIGHT 16
+#endif
+
+typedef struct
+{
+    // Name of the channel in the log
+    const char *name;
+
+    // Deadband of a quiet sensor and the largest deadband of a noisy one, equal values turn the adaptation off
+    float deadband_min;
+    float deadband_max;
+
+    // Shortest time between the publications of a change and the longest time without a publication
+    twr_tick_t min_interval;
+    twr_tick_t max_interval;
+} report_config_t;
+
+typedef struct
+{
+    uint32_t readings;
+    uint32_t changes;
+    uint32_t heartbeats;
+
+    // Readings over the deadband that waited for the shortest interval
+    uint32_t held_back;
+} report_stats_t;
+
+typedef struct
+{
+    const report_config_t *config;
+
+    float published;
+    twr_tick_t published_tick;
+    bool has_published;
+
+    // Last two readings and the noise estimated from them
+    float history[2];
+    int history_length;
+    float noise;
+
+    report_stats_t stats;
+} report_t;
+
+void report_init(report_t *self, const report_config_t *config);
+bool report_update(report_t *self, float value);
+float report_get_deadband(const report_t *self);
+const report_stats_t *report_get_stats(const report_t *self);
+
+#endif // _REPORT_H
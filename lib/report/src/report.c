@@ -0,0 +1,108 @@
+/*
+Report on change of a measured value
+*/
+
+#include <report.h>
+#include <string.h>
+#include <math.h>
+
+void report_init(report_t *self, const report_config_t *config)
+{
+    memset(self, 0, sizeof(*self));
+
+    self->config = config;
+}
+
+/*
+This function will update the noise estimate with the second difference of the last three readings
+
+The mean absolute second difference of a white noise is about twice its standard deviation.
+*/
+static void report_update_noise(report_t *self, float value)
+{
+    if (self->history_length == 2)
+    {
+        float difference = value - 2 * self->history[1] + self->history[0];
+
+        self->noise += (fabsf(difference) / 2 - self->noise) / REPORT_NOISE_WEIGHT;
+    }
+    else
+    {
+        self->history_length++;
+    }
+
+    self->history[0] = self->history[1];
+    self->history[1] = value;
+}
+
+/*
+This function will take the reading and return true when it should be published, the reading is taken as published then
+*/
+bool report_update(report_t *self, float value)
+{
+    const report_config_t *config = self->config;
+    twr_tick_t now = twr_scheduler_get_spin_tick();
+
+    if (isnan(value))
+    {
+        return false;
+    }
+
+    self->stats.readings++;
+
+    report_update_noise(self, value);
+
+    if (!self->has_published || fabsf(value - self->published) >= report_get_deadband(self))
+    {
+        if (self->has_published && now - self->published_tick < config->min_interval)
+        {
+            self->stats.held_back++;
+
+            return false;
+        }
+
+        self->stats.changes++;
+    }
+    else if (now - self->published_tick >= config->max_interval)
+    {
+        self->stats.heartbeats++;
+    }
+    else
+    {
+        return false;
+    }
+
+    self->published = value;
+    self->published_tick = now;
+    self->has_published = true;
+
+    twr_log_debug("$REPORT: %s %.2f, deadband %.2f, %lu of %lu readings published", config->name, value, report_get_deadband(self),
+                  (unsigned long) (self->stats.changes + self->stats.heartbeats), (unsigned long) self->stats.readings);
+
+    return true;
+}
+
+/*
+This function will return the deadband for the current noise estimate
+*/
+float report_get_deadband(const report_t *self)
+{
+    float deadband = REPORT_NOISE_FACTOR * self->noise;
+
+    if (deadband < self->config->deadband_min)
+    {
+        return self->config->deadband_min;
+    }
+
+    if (deadband > self->config->deadband_max)
+    {
+        return self->config->deadband_max;
+    }
+
+    return deadband;
+}
+
+const report_stats_t *report_get_stats(const report_t *self)
+{
+    return &self->stats;
+}
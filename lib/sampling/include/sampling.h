@@ -0,0 +1,55 @@
+/*
+Update interval of a sensor adapting to the rate of change of its value
+
+The slope of the value is taken from the last two readings. The interval is the time the value needs at that slope to
+change by SAMPLING_TARGET times the given change, usually the deadband of the reported value, limited by the interval
+range of the sensor. A faster change shortens the interval right away, a slower one lengthens it at most
+SAMPLING_GROWTH times per reading, so a single quiet pair of readings does not jump to the longest interval.
+
+The sensors measure once more when their interval is set, a reading sooner than half of the interval after the previous
+one is not used for the slope.
+*/
+
+#ifndef _SAMPLING_H
+#define _SAMPLING_H
+
+#include <twr.h>
+
+// Part of the change the value may move by between two readings
+#ifndef SAMPLING_TARGET
+#define SAMPLING_TARGET 0.5f
+#endif
+
+// Largest factor the interval grows by per reading
+#ifndef SAMPLING_GROWTH
+#define SAMPLING_GROWTH 2
+#endif
+
+typedef struct
+{
+    // Name of the sensor in the log
+    const char *name;
+
+    twr_tick_t min_interval;
+    twr_tick_t max_interval;
+} sampling_config_t;
+
+typedef struct
+{
+    const sampling_config_t *config;
+
+    twr_tick_t interval;
+
+    float last;
+    twr_tick_t last_tick;
+    bool has_last;
+
+    uint32_t readings;
+    uint32_t changes;
+} sampling_t;
+
+void sampling_init(sampling_t *self, const sampling_config_t *config);
+bool sampling_update(sampling_t *self, float value, float change);
+twr_tick_t sampling_get_interval(const sampling_t *self);
+
+#endif // _SAMPLING_H
@@ -0,0 +1,92 @@
+/*
+Update interval of a sensor adapting to the rate of change of its value
+*/
+
+#include <sampling.h>
+#include <string.h>
+#include <math.h>
+
+void sampling_init(sampling_t *self, const sampling_config_t *config)
+{
+    memset(self, 0, sizeof(*self));
+
+    self->config = config;
+    self->interval = config->min_interval;
+}
+
+/*
+This function will take the reading and return true when the update interval of the sensor should be changed
+*/
+bool sampling_update(sampling_t *self, float value, float change)
+{
+    const sampling_config_t *config = self->config;
+    twr_tick_t now = twr_scheduler_get_spin_tick();
+
+    if (isnan(value))
+    {
+        return false;
+    }
+
+    if (!self->has_last)
+    {
+        self->last = value;
+        self->last_tick = now;
+        self->has_last = true;
+
+        return false;
+    }
+
+    twr_tick_t elapsed = now - self->last_tick;
+
+    if (elapsed < self->interval / 2)
+    {
+        return false;
+    }
+
+    float difference = fabsf(value - self->last);
+
+    self->last = value;
+    self->last_tick = now;
+    self->readings++;
+
+    float interval = (float) self->interval * SAMPLING_GROWTH;
+
+    if (difference > 0)
+    {
+        float target = (float) elapsed * SAMPLING_TARGET * change / difference;
+
+        if (target < interval)
+        {
+            interval = target;
+        }
+    }
+
+    if (interval < config->min_interval)
+    {
+        interval = config->min_interval;
+    }
+
+    if (interval > config->max_interval)
+    {
+        interval = config->max_interval;
+    }
+
+    // Small corrections are not worth the extra measurement of setting the interval
+    if (fabsf(interval - self->interval) < self->interval / 4.0f)
+    {
+        return false;
+    }
+
+    self->interval = (twr_tick_t) interval;
+    self->changes++;
+
+    twr_log_debug("$SAMPLING: %s every %lu ms, %lu changes in %lu readings", config->name, (unsigned long) self->interval,
+                  (unsigned long) self->changes, (unsigned long) self->readings);
+
+    return true;
+}
+
+twr_tick_t sampling_get_interval(const sampling_t *self)
+{
+    return self->interval;
+}
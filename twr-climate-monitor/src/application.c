@@ -6,31 +6,45 @@ Date: 2.4.2021
 */
 
 #include <application.h>
+#include <report.h>
+#include <publish_queue.h>
+#include <sampling.h>
 
 #define BATTERY_UPDATE_INTERVAL (60 * MINUTE)
+#define CLIMATE_PUB_MIN_INTERVAL (30 * 1000)
 #define CLIMATE_PUB_NO_CHANGE_INTEVAL (15 * MINUTE)
-#define VALUE_TEMPERATURE_CHANGE_PUB_TRESHOLD 0.2f
-#define VALUE_HUMIDITY_CHANGE_PUB_TRESHOLD 1.0f
-#define VALUE_LUX_CHANGE_PUB_TRESHOLD 25.0f
-#define BAROMETER_TAG_PUB_NO_CHANGE_INTEVAL (5 * MINUTE)
-#define PRESSURE_VALUE_CHANGE_PUB_TRESHOLD 10.0f
-
-float temperature;
-twr_tick_t nextTemperaturePublish;
-
-float humidity;
-twr_tick_t nextHumidityPublish;
-
-float luxValue;
-twr_tick_t nextLuxPublish;
-
-float pressure;
-twr_tick_t nextPressurePublish;
+#define CLIMATE_PUB_WINDOW 2000
+
+// Deadbands of the values, from the deadband of a quiet sensor to the largest one for a noisy sensor, and the publication
+// intervals, the heartbeat of all values is sent by the publish queue
+static const report_config_t temperature_report_config = { "temperature", 0.2f, 0.6f, CLIMATE_PUB_MIN_INTERVAL, TWR_TICK_INFINITY };
+static const report_config_t humidity_report_config = { "humidity", 1.0f, 3.0f, CLIMATE_PUB_MIN_INTERVAL, TWR_TICK_INFINITY };
+static const report_config_t lux_report_config = { "illuminance", 25.0f, 100.0f, CLIMATE_PUB_MIN_INTERVAL, TWR_TICK_INFINITY };
+static const report_config_t pressure_report_config = { "pressure", 10.0f, 40.0f, CLIMATE_PUB_MIN_INTERVAL, TWR_TICK_INFINITY };
+
+// Update intervals of the sensors, from the interval of a changing value to the longest one of a steady value
+static const sampling_config_t temperature_sampling_config = { "thermometer", 5000, 2 * MINUTE };
+static const sampling_config_t humidity_sampling_config = { "hygrometer", 5000, 2 * MINUTE };
+static const sampling_config_t lux_sampling_config = { "lux meter", 5000, MINUTE };
+static const sampling_config_t pressure_sampling_config = { "barometer", 5000, 10 * MINUTE };
+
+// Values go over the radio in compound packets, the Node-RED flows publish them on their usual topics
+publish_queue_t publish_queue;
+
+report_t temperature_report;
+report_t humidity_report;
+report_t lux_report;
+report_t pressure_report;
+
+sampling_t temperature_sampling;
+sampling_t humidity_sampling;
+sampling_t lux_sampling;
+sampling_t pressure_sampling;
 
 /*
 Event handler for the Battery module
 
-This function will just send the battery percentage and charge over MQTT so it can be monitored
+This function will just queue the battery percentage and charge for sending over MQTT so it can be monitored
 */
 void battery_event_handler(twr_module_battery_event_t event, void *event_param)
 {
@@ -39,20 +53,20 @@ void battery_event_handler(twr_module_battery_event_t event, void *event_param)
 
     if (twr_module_battery_get_voltage(&voltage))
     {
-        twr_radio_pub_battery(&voltage);
+        publish_queue_set(&publish_queue, PUBLISH_TOPIC_VOLTAGE, voltage);
     }
 
     if (twr_module_battery_get_charge_level(&percentage))
     {
-        twr_radio_pub_int("voltage/percentage", &percentage);
+        publish_queue_set(&publish_queue, PUBLISH_TOPIC_PERCENTAGE, percentage);
     }
 }
 
 /*
-This function measures the data from the sensors on climate module and send them over MQTT
+This function measures the data from the sensors on climate module and queue them for sending over MQTT
 
-This function will be called every 5000ms.
-Data will be sent over MQTT if some significant change occurres or after fixed time to save battery life
+This function will be called every 5 s when the values change, less often when they are steady.
+Data will be sent over MQTT if some significant change occurres, the changes of one measurement go in one packet to save battery life
 */
 void climate_module_event_handler(twr_module_climate_event_t event, void *event_param)
 {
@@ -61,11 +75,14 @@ void climate_module_event_handler(twr_module_climate_event_t event, void *event_
         float celsius;
         twr_module_climate_get_temperature_celsius(&celsius);
 
-        if ((fabs(celsius - temperature) >= VALUE_TEMPERATURE_CHANGE_PUB_TRESHOLD) || (nextTemperaturePublish < twr_scheduler_get_spin_tick()))
+        if (report_update(&temperature_report, celsius))
+        {
+            publish_queue_set(&publish_queue, PUBLISH_TOPIC_TEMPERATURE, celsius);
+        }
+
+        if (sampling_update(&temperature_sampling, celsius, report_get_deadband(&temperature_report)))
         {
-            twr_radio_pub_temperature(TWR_RADIO_PUB_CHANNEL_R1_I2C0_ADDRESS_DEFAULT, &celsius);
-            temperature = celsius;
-            nextTemperaturePublish = twr_scheduler_get_spin_tick() + CLIMATE_PUB_NO_CHANGE_INTEVAL;
+            twr_module_climate_set_update_interval_thermometer(sampling_get_interval(&temperature_sampling));
         }
     }
     else if (event == TWR_MODULE_CLIMATE_EVENT_UPDATE_HYGROMETER)
@@ -73,11 +90,14 @@ void climate_module_event_handler(twr_module_climate_event_t event, void *event_
         float percentage;
         twr_module_climate_get_humidity_percentage(&percentage);
 
-        if ((fabs(percentage - humidity) >= VALUE_HUMIDITY_CHANGE_PUB_TRESHOLD) || (nextHumidityPublish < twr_scheduler_get_spin_tick()))
+        if (report_update(&humidity_report, percentage))
+        {
+            publish_queue_set(&publish_queue, PUBLISH_TOPIC_HUMIDITY, percentage);
+        }
+
+        if (sampling_update(&humidity_sampling, percentage, report_get_deadband(&humidity_report)))
         {
-            twr_radio_pub_humidity(TWR_RADIO_PUB_CHANNEL_R1_I2C0_ADDRESS_DEFAULT, &percentage);
-            humidity = percentage;
-            nextHumidityPublish = twr_scheduler_get_spin_tick() + CLIMATE_PUB_NO_CHANGE_INTEVAL;
+            twr_module_climate_set_update_interval_hygrometer(sampling_get_interval(&humidity_sampling));
         }
     }
     else if (event == TWR_MODULE_CLIMATE_EVENT_UPDATE_LUX_METER)
@@ -85,11 +105,14 @@ void climate_module_event_handler(twr_module_climate_event_t event, void *event_
         float lux;
         twr_module_climate_get_illuminance_lux(&lux);
 
-        if ((fabs(lux - luxValue) >= VALUE_LUX_CHANGE_PUB_TRESHOLD) || (nextLuxPublish < twr_scheduler_get_spin_tick()))
+        if (report_update(&lux_report, lux))
         {
-            twr_radio_pub_luminosity(TWR_RADIO_PUB_CHANNEL_R1_I2C0_ADDRESS_DEFAULT, &lux);
-            luxValue = lux;
-            nextLuxPublish = twr_scheduler_get_spin_tick() + CLIMATE_PUB_NO_CHANGE_INTEVAL;
+            publish_queue_set(&publish_queue, PUBLISH_TOPIC_ILLUMINANCE, lux);
+        }
+
+        if (sampling_update(&lux_sampling, lux, report_get_deadband(&lux_report)))
+        {
+            twr_module_climate_set_update_interval_lux_meter(sampling_get_interval(&lux_sampling));
         }
     }
     else if (event == TWR_MODULE_CLIMATE_EVENT_UPDATE_BAROMETER)
@@ -97,11 +120,14 @@ void climate_module_event_handler(twr_module_climate_event_t event, void *event_
         float pascals;
         twr_module_climate_get_pressure_pascal(&pascals);
 
-        if ((fabs(pascals - pressure) >= PRESSURE_VALUE_CHANGE_PUB_TRESHOLD) || (nextPressurePublish < twr_scheduler_get_spin_tick()))
+        if (report_update(&pressure_report, pascals))
         {
-            twr_radio_pub_barometer(TWR_RADIO_PUB_CHANNEL_R1_I2C0_ADDRESS_DEFAULT, &pascals, NULL);
-            pressure = pascals;
-            nextPressurePublish = twr_scheduler_get_spin_tick() + CLIMATE_PUB_NO_CHANGE_INTEVAL;
+            publish_queue_set(&publish_queue, PUBLISH_TOPIC_PRESSURE, pascals);
+        }
+
+        if (sampling_update(&pressure_sampling, pascals, report_get_deadband(&pressure_report)))
+        {
+            twr_module_climate_set_update_interval_barometer(sampling_get_interval(&pressure_sampling));
         }
     }
 }
@@ -113,13 +139,26 @@ void application_init(void)
 {
     twr_log_init(TWR_LOG_LEVEL_DUMP, TWR_LOG_TIMESTAMP_ABS);
 
+    report_init(&temperature_report, &temperature_report_config);
+    report_init(&humidity_report, &humidity_report_config);
+    report_init(&lux_report, &lux_report_config);
+    report_init(&pressure_report, &pressure_report_config);
+
+    sampling_init(&temperature_sampling, &temperature_sampling_config);
+    sampling_init(&humidity_sampling, &humidity_sampling_config);
+    sampling_init(&lux_sampling, &lux_sampling_config);
+    sampling_init(&pressure_sampling, &pressure_sampling_config);
+
+    // All values of the node go in compound packets with one heartbeat
+    publish_queue_init(&publish_queue, CLIMATE_PUB_WINDOW, CLIMATE_PUB_NO_CHANGE_INTEVAL);
+
     // Climate module inicialization
     twr_module_climate_init();
     twr_module_climate_set_event_handler(climate_module_event_handler, NULL);
-    twr_module_climate_set_update_interval_thermometer(5000);
-    twr_module_climate_set_update_interval_hygrometer(5000);
-    twr_module_climate_set_update_interval_lux_meter(5000);
-    twr_module_climate_set_update_interval_barometer(5000);
+    twr_module_climate_set_update_interval_thermometer(sampling_get_interval(&temperature_sampling));
+    twr_module_climate_set_update_interval_hygrometer(sampling_get_interval(&humidity_sampling));
+    twr_module_climate_set_update_interval_lux_meter(sampling_get_interval(&lux_sampling));
+    twr_module_climate_set_update_interval_barometer(sampling_get_interval(&pressure_sampling));
     twr_module_climate_measure_all_sensors();
 
     // Batery module inicialization
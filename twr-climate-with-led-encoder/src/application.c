@@ -6,18 +6,44 @@ Date: 2.4.2021
 */
 
 #include <application.h>
+#include <report.h>
+#include <publish_queue.h>
+#include <sampling.h>
+#include <bus_scheduler.h>
 
-#define TEMPERATURE_TAG_PUB_NO_CHANGE_INTEVAL (5 * MINUTE)
-#define TEMPERATURE_VALUE_CHANGE_PUB_TRESHOLD 0.2f
+// Heartbeat of all values together
+#define VALUE_PUB_NO_CHANGE_INTEVAL (5 * MINUTE)
 
-#define BAROMETER_TAG_PUB_NO_CHANGE_INTEVAL (5 * MINUTE)
-#define PRESSURE_VALUE_CHANGE_PUB_TRESHOLD 10.0f
+// Shortest time between the publications of a changed value
+#define VALUE_PUB_MIN_INTERVAL (30 * 1000)
 
-#define HUMIDITY_TAG_PUB_NO_CHANGE_INTEVAL (5 * MINUTE)
-#define HUMIDITY_VALUE_CHANGE_PUB_TRESHOLD 1.0f
+// Changes measured within the window go in one packet
+#define VALUE_PUB_WINDOW 2000
 
-#define VOC_TAG_PUB_NO_CHANGE_INTEVAL (5 * MINUTE)
-#define VOC_VALUE_CHANGE_PUB_TRESHOLD 5.0f
+// Deadbands of the values, from the deadband of a quiet sensor to the largest one for a noisy sensor, and the publication
+// intervals, the heartbeat of all values is sent by the publish queue
+static const report_config_t temperature_report_config = { "temperature", 0.2f, 0.6f, VALUE_PUB_MIN_INTERVAL, TWR_TICK_INFINITY };
+static const report_config_t pressure_report_config = { "pressure", 10.0f, 40.0f, VALUE_PUB_MIN_INTERVAL, TWR_TICK_INFINITY };
+static const report_config_t humidity_report_config = { "humidity", 1.0f, 3.0f, VALUE_PUB_MIN_INTERVAL, TWR_TICK_INFINITY };
+static const report_config_t voc_report_config = { "voc", 5.0f, 20.0f, VALUE_PUB_MIN_INTERVAL, TWR_TICK_INFINITY };
+
+// Update intervals of the sensors, from the interval of a changing value to the longest one of a steady value
+static const sampling_config_t temperature_sampling_config = { "tmp112", 5000, 2 * MINUTE };
+static const sampling_config_t pressure_sampling_config = { "barometer", 5000, 5 * MINUTE };
+static const sampling_config_t humidity_sampling_config = { "humidity", 5000, 2 * MINUTE };
+static const sampling_config_t voc_sampling_config = { "voc", 5000, MINUTE };
+
+// All tags on the I2C0 bus measure in the same slots, the shortest update interval of the tags
+#define I2C0_BUS_SLOT_INTERVAL 5000
+
+// Values go over the radio in compound packets, the Node-RED flows publish them on their usual topics
+publish_queue_t publish_queue;
+
+bus_scheduler_t i2c0_bus;
+int temperature_bus_index;
+int pressure_bus_index;
+int humidity_bus_index;
+int voc_bus_index;
 
 #define LED_STRIP_COUNT 144
 #define LED_STRIP_TYPE 4
@@ -25,20 +51,20 @@ Date: 2.4.2021
 #define LED_BRIGHTNESS_INCREMENT 20
 
 twr_tmp112_t tmp112;
-float temperature;
-twr_tick_t nextTemperaturePublish;
+report_t temperature_report;
+sampling_t temperature_sampling;
 
 twr_tag_barometer_t barometerTag;
-float pressure;
-twr_tick_t nextPressurePublish;
+report_t pressure_report;
+sampling_t pressure_sampling;
 
 twr_tag_humidity_t humidityTag;
-float humidity;
-twr_tick_t nextHumidityPublish;
+report_t humidity_report;
+sampling_t humidity_sampling;
 
 twr_tag_voc_lp_t vocLpTag;
-uint16_t vocLp;
-twr_tick_t nextVOCPublish;
+report_t voc_report;
+sampling_t voc_sampling;
 
 static uint32_t _twr_module_power_led_strip_dma_buffer[LED_STRIP_COUNT * LED_STRIP_TYPE * 2];
 const twr_led_strip_buffer_t led_strip_buffer =
@@ -165,25 +191,53 @@ void twr_radio_node_on_led_strip_effect_set(uint64_t *id, twr_radio_node_led_str
 
 
 
+/*
+Functions starting the measurements of the tags for the bus scheduler
+*/
+static bool tmp112_measure(void *sensor)
+{
+    return twr_tmp112_measure(sensor);
+}
+
+static bool barometer_tag_measure(void *sensor)
+{
+    return twr_tag_barometer_measure(sensor);
+}
+
+static bool humidity_tag_measure(void *sensor)
+{
+    return twr_tag_humidity_measure(sensor);
+}
+
+static bool voc_lp_measure(void *sensor)
+{
+    return twr_tag_voc_lp_measure(sensor);
+}
+
 /*
 Event handler for the Temperature sensor
 
-It will detect the update and send the value over MQTT in case there is a big change or the selected time
-elapsed from the last message
+It will detect the update and queue the value for sending over MQTT in case there is a big change, the publish
+queue sends it again after the selected time
 */
 void tmp112_event_handler(twr_tmp112_t *self, twr_tmp112_event_t event, void *event_param)
 {
+    bus_scheduler_done(&i2c0_bus, temperature_bus_index);
+
     if (event == TWR_TMP112_EVENT_UPDATE)
     {
         float celsius;
         twr_tmp112_get_temperature_celsius(self, &celsius);
 
         // Read temperature
-        if ((fabs(celsius - temperature) >= TEMPERATURE_VALUE_CHANGE_PUB_TRESHOLD) || (nextTemperaturePublish < twr_scheduler_get_spin_tick()))
+        if (report_update(&temperature_report, celsius))
         {
-            twr_radio_pub_temperature(TWR_RADIO_PUB_CHANNEL_R1_I2C0_ADDRESS_DEFAULT, &celsius);
-            temperature = celsius;
-            nextTemperaturePublish = twr_scheduler_get_spin_tick() + TEMPERATURE_TAG_PUB_NO_CHANGE_INTEVAL;
+            publish_queue_set(&publish_queue, PUBLISH_TOPIC_TEMPERATURE, celsius);
+        }
+
+        if (sampling_update(&temperature_sampling, celsius, report_get_deadband(&temperature_report)))
+        {
+            bus_scheduler_set_interval(&i2c0_bus, temperature_bus_index, sampling_get_interval(&temperature_sampling));
         }
     }
 }
@@ -191,21 +245,26 @@ void tmp112_event_handler(twr_tmp112_t *self, twr_tmp112_event_t event, void *ev
 /*
 Event handler for the Barometer tag
 
-It will detect the update and send the value over MQTT in case there is a big change or the selected time
-elapsed from the last message
+It will detect the update and queue the value for sending over MQTT in case there is a big change, the publish
+queue sends it again after the selected time
 */
 void barometer_tag_event_handler(twr_tag_barometer_t *self, twr_tag_barometer_event_t event, void *event_param)
 {
+    bus_scheduler_done(&i2c0_bus, pressure_bus_index);
+
     if(event == TWR_TAG_BAROMETER_EVENT_UPDATE)
     {
         float pascals;
         twr_tag_barometer_get_pressure_pascal(self, &pascals);
 
-        if ((fabs(pascals - pressure) >= PRESSURE_VALUE_CHANGE_PUB_TRESHOLD) || (nextPressurePublish < twr_scheduler_get_spin_tick()))
+        if (report_update(&pressure_report, pascals))
+        {
+            publish_queue_set(&publish_queue, PUBLISH_TOPIC_PRESSURE, pascals);
+        }
+
+        if (sampling_update(&pressure_sampling, pascals, report_get_deadband(&pressure_report)))
         {
-            twr_radio_pub_barometer(TWR_RADIO_PUB_CHANNEL_R1_I2C0_ADDRESS_DEFAULT, &pascals, NULL);
-            pressure = pascals;
-            nextPressurePublish = twr_scheduler_get_spin_tick() + BAROMETER_TAG_PUB_NO_CHANGE_INTEVAL;
+            bus_scheduler_set_interval(&i2c0_bus, pressure_bus_index, sampling_get_interval(&pressure_sampling));
         }
     }
 }
@@ -213,21 +272,26 @@ void barometer_tag_event_handler(twr_tag_barometer_t *self, twr_tag_barometer_ev
 /*
 Event handler for the Humidity tag
 
-It will detect the update and send the value over MQTT in case there is a big change or the selected time
-elapsed from the last message
+It will detect the update and queue the value for sending over MQTT in case there is a big change, the publish
+queue sends it again after the selected time
 */
 void humidity_tag_event_handler(twr_tag_humidity_t *self, twr_tag_humidity_event_t event, void *event_param)
 {
+    bus_scheduler_done(&i2c0_bus, humidity_bus_index);
+
     if(event == TWR_TAG_HUMIDITY_EVENT_UPDATE)
     {
         float percentage;
         twr_tag_humidity_get_humidity_percentage(self, &percentage);
 
-        if ((fabs(percentage - humidity) >= HUMIDITY_VALUE_CHANGE_PUB_TRESHOLD) || (nextHumidityPublish < twr_scheduler_get_spin_tick()))
+        if (report_update(&humidity_report, percentage))
         {
-            twr_radio_pub_humidity(TWR_RADIO_PUB_CHANNEL_R1_I2C0_ADDRESS_DEFAULT, &percentage);
-            humidity = percentage;
-            nextHumidityPublish = twr_scheduler_get_spin_tick() + HUMIDITY_TAG_PUB_NO_CHANGE_INTEVAL;
+            publish_queue_set(&publish_queue, PUBLISH_TOPIC_HUMIDITY, percentage);
+        }
+
+        if (sampling_update(&humidity_sampling, percentage, report_get_deadband(&humidity_report)))
+        {
+            bus_scheduler_set_interval(&i2c0_bus, humidity_bus_index, sampling_get_interval(&humidity_sampling));
         }
     }
 }
@@ -235,22 +299,26 @@ void humidity_tag_event_handler(twr_tag_humidity_t *self, twr_tag_humidity_event
 /*
 Event handler for the VOC tag
 
-It will detect the update and send the value over MQTT in case there is a big change or the selected time
-elapsed from the last message
+It will detect the update and queue the value for sending over MQTT in case there is a big change, the publish
+queue sends it again after the selected time
 */
 void voc_lp_event_handler(twr_tag_voc_lp_t *self, twr_tag_voc_lp_event_t event, void *event_param)
 {
+    bus_scheduler_done(&i2c0_bus, voc_bus_index);
+
     if(event == TWR_TAG_VOC_LP_EVENT_UPDATE)
     {
         uint16_t vocLpPpb;
         twr_tag_voc_lp_get_tvoc_ppb(self, &vocLpPpb);
 
-        if ((fabs(vocLpPpb - vocLp) >= VOC_VALUE_CHANGE_PUB_TRESHOLD) || (nextVOCPublish < twr_scheduler_get_spin_tick()))
+        if (report_update(&voc_report, vocLpPpb))
+        {
+            publish_queue_set(&publish_queue, PUBLISH_TOPIC_TVOC, vocLpPpb);
+        }
+
+        if (sampling_update(&voc_sampling, vocLpPpb, report_get_deadband(&voc_report)))
         {
-            int sendedValue = vocLpPpb;
-            twr_radio_pub_int("voc-lp-sensor/0:0/tvoc", &sendedValue);
-            vocLp = vocLpPpb;
-            nextVOCPublish = twr_scheduler_get_spin_tick() + VOC_TAG_PUB_NO_CHANGE_INTEVAL;
+            bus_scheduler_set_interval(&i2c0_bus, voc_bus_index, sampling_get_interval(&voc_sampling));
         }
     }
 }
@@ -446,21 +514,37 @@ void application_init(void)
 {
     twr_log_init(TWR_LOG_LEVEL_DUMP, TWR_LOG_TIMESTAMP_ABS);
 
+    report_init(&temperature_report, &temperature_report_config);
+    report_init(&pressure_report, &pressure_report_config);
+    report_init(&humidity_report, &humidity_report_config);
+    report_init(&voc_report, &voc_report_config);
+
+    sampling_init(&temperature_sampling, &temperature_sampling_config);
+    sampling_init(&pressure_sampling, &pressure_sampling_config);
+    sampling_init(&humidity_sampling, &humidity_sampling_config);
+    sampling_init(&voc_sampling, &voc_sampling_config);
+
+    // All values of the node go in compound packets with one heartbeat
+    publish_queue_init(&publish_queue, VALUE_PUB_WINDOW, VALUE_PUB_NO_CHANGE_INTEVAL);
+
+    // The tags do not run their own update intervals, the bus scheduler starts their measurements
+    bus_scheduler_init(&i2c0_bus, I2C0_BUS_SLOT_INTERVAL);
+
     twr_tmp112_init(&tmp112, TWR_I2C_I2C0, 0x49);
     twr_tmp112_set_event_handler(&tmp112, tmp112_event_handler, NULL);
-    twr_tmp112_set_update_interval(&tmp112, 5000);
+    temperature_bus_index = bus_scheduler_add(&i2c0_bus, "tmp112", tmp112_measure, &tmp112, sampling_get_interval(&temperature_sampling));
 
     twr_tag_barometer_init(&barometerTag, TWR_I2C_I2C0);
     twr_tag_barometer_set_event_handler(&barometerTag, barometer_tag_event_handler, NULL);
-    twr_tag_barometer_set_update_interval(&barometerTag, 5000);
+    pressure_bus_index = bus_scheduler_add(&i2c0_bus, "barometer", barometer_tag_measure, &barometerTag, sampling_get_interval(&pressure_sampling));
 
     twr_tag_humidity_init(&humidityTag, TWR_TAG_HUMIDITY_REVISION_R3, TWR_I2C_I2C0, TWR_TAG_HUMIDITY_I2C_ADDRESS_DEFAULT);
     twr_tag_humidity_set_event_handler(&humidityTag, humidity_tag_event_handler, NULL);
-    twr_tag_humidity_set_update_interval(&humidityTag, 5000);
+    humidity_bus_index = bus_scheduler_add(&i2c0_bus, "humidity", humidity_tag_measure, &humidityTag, sampling_get_interval(&humidity_sampling));
 
     twr_tag_voc_lp_init(&vocLpTag, TWR_I2C_I2C0);
     twr_tag_voc_lp_set_event_handler(&vocLpTag, voc_lp_event_handler, NULL);
-    twr_tag_voc_lp_set_update_interval(&vocLpTag, 5000);
+    voc_bus_index = bus_scheduler_add(&i2c0_bus, "voc", voc_lp_measure, &vocLpTag, sampling_get_interval(&voc_sampling));
 
     twr_module_encoder_init();
     twr_module_encoder_set_event_handler(encoder_event_handler, NULL);
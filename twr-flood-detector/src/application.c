@@ -5,12 +5,18 @@ Author: Jakub Smejkal
 Date: 2.4.2021
 */
 #include <application.h>
+#include <report.h>
+#include <sampling.h>
 
 #define FLOOD_DETECTOR_NO_CHANGE_INTEVAL (15 * MINUTE)
 #define FLOOD_DETECTOR_UPDATE_NORMAL_INTERVAL  (5 * 1000)
 
+#define TEMPERATURE_TAG_PUB_MIN_INTERVAL (30 * 1000)
 #define TEMPERATURE_TAG_PUB_NO_CHANGE_INTEVAL (15 * MINUTE)
-#define VALUE_CHANGE_PUB_TRESHOLD 0.2f
+
+// Update interval of the temperature while it changes and the longest one while it is steady
+#define TEMPERATURE_TAG_UPDATE_MIN_INTERVAL (5 * 1000)
+#define TEMPERATURE_TAG_UPDATE_MAX_INTERVAL (2 * MINUTE)
 
 #define BATTERY_UPDATE_INTERVAL (60 * MINUTE)
 
@@ -18,11 +24,14 @@ twr_tmp112_t tmp112;
 
 twr_flood_detector_t flood_detector;
 
-bool alarmState;
-twr_tick_t nextFloodPublish;
+// The alarm is reported as 0 or 1 with a fixed deadband, every change is published right away
+static const report_config_t flood_report_config = { "flood", 0.5f, 0.5f, 0, FLOOD_DETECTOR_NO_CHANGE_INTEVAL };
+static const report_config_t temperature_report_config = { "temperature", 0.2f, 0.6f, TEMPERATURE_TAG_PUB_MIN_INTERVAL, TEMPERATURE_TAG_PUB_NO_CHANGE_INTEVAL };
+static const sampling_config_t temperature_sampling_config = { "tmp112", TEMPERATURE_TAG_UPDATE_MIN_INTERVAL, TEMPERATURE_TAG_UPDATE_MAX_INTERVAL };
 
-float temperature;
-twr_tick_t nextTemperaturePublish;
+report_t flood_report;
+report_t temperature_report;
+sampling_t temperature_sampling;
 
 /*
 Event handler for the Battery module
@@ -58,12 +67,9 @@ void flood_detector_event_handler(twr_flood_detector_t *self, twr_flood_detector
     {
        is_alarm = twr_flood_detector_is_alarm(self);
 
-       if ((is_alarm != alarmState) || (nextFloodPublish < twr_scheduler_get_spin_tick()))
+       if (report_update(&flood_report, is_alarm ? 1.0f : 0.0f))
        {
            twr_radio_pub_bool("flood-detector/a/alarm", &is_alarm);
-
-           alarmState = is_alarm;
-           nextFloodPublish = twr_scheduler_get_spin_tick() + FLOOD_DETECTOR_NO_CHANGE_INTEVAL;
        }
     }
 }
@@ -81,12 +87,15 @@ void tmp112_event_handler(twr_tmp112_t *self, twr_tmp112_event_t event, void *ev
         float celsius;
         twr_tmp112_get_temperature_celsius(self, &celsius);
 
-        if ((fabs(celsius - temperature) >= VALUE_CHANGE_PUB_TRESHOLD) || (nextTemperaturePublish < twr_scheduler_get_spin_tick()))
+        if (report_update(&temperature_report, celsius))
         {
             twr_log_debug("APP: temperature: %.2f °C", celsius);
             twr_radio_pub_temperature(TWR_RADIO_PUB_CHANNEL_R1_I2C0_ADDRESS_DEFAULT, &celsius);
-            temperature = celsius;
-            nextTemperaturePublish = twr_scheduler_get_spin_tick() + TEMPERATURE_TAG_PUB_NO_CHANGE_INTEVAL;
+        }
+
+        if (sampling_update(&temperature_sampling, celsius, report_get_deadband(&temperature_report)))
+        {
+            twr_tmp112_set_update_interval(self, sampling_get_interval(&temperature_sampling));
         }
     }
 }
@@ -98,10 +107,14 @@ void application_init(void)
 {
     twr_log_init(TWR_LOG_LEVEL_DUMP, TWR_LOG_TIMESTAMP_ABS);
 
+    report_init(&flood_report, &flood_report_config);
+    report_init(&temperature_report, &temperature_report_config);
+    sampling_init(&temperature_sampling, &temperature_sampling_config);
+
     // Temperature sensor inicialization
     twr_tmp112_init(&tmp112, TWR_I2C_I2C0, 0x49);
     twr_tmp112_set_event_handler(&tmp112, tmp112_event_handler, NULL);
-    twr_tmp112_set_update_interval(&tmp112, 5000);
+    twr_tmp112_set_update_interval(&tmp112, sampling_get_interval(&temperature_sampling));
 
     twr_flood_detector_init(&flood_detector, TWR_FLOOD_DETECTOR_TYPE_LD_81_SENSOR_MODULE_CHANNEL_A);
     twr_flood_detector_set_event_handler(&flood_detector, flood_detector_event_handler, NULL);
@@ -8,34 +8,44 @@ Date: 2.4.2021
 */
 
 #include <application.h>
+#include <report.h>
+#include <sampling.h>
 
 #define TEMPERATURE_TAG_PUB_NO_CHANGE_INTEVAL (15 * MINUTE)
-#define VALUE_CHANGE_PUB_TRESHOLD 0.2f
 
 #define NO_MOVEMENT_DETECTED_INTERVAL (MINUTE)
 
 #define BATTERY_UPDATE_INTERVAL (60 * MINUTE)
 
 #define CO2_PUB_NO_CHANGE_INTERVAL (15 * MINUTE)
-#define CO2_CHANGE_PUB_TRESHOLD 50.0f
 
 #define HUMIDITY_TAG_PUB_NO_CHANGE_INTEVAL (15 * MINUTE)
-#define HUMIDITY_VALUE_CHANGE_PUB_TRESHOLD 1.0f
+
+// Shortest time between the publications of a changed value
+#define VALUE_PUB_MIN_INTERVAL (30 * 1000)
+
+// Deadbands of the values, from the deadband of a quiet sensor to the largest one for a noisy sensor, and the publication intervals
+static const report_config_t temperature_report_config = { "temperature", 0.2f, 0.6f, VALUE_PUB_MIN_INTERVAL, TEMPERATURE_TAG_PUB_NO_CHANGE_INTEVAL };
+static const report_config_t co2_report_config = { "co2", 50.0f, 150.0f, VALUE_PUB_MIN_INTERVAL, CO2_PUB_NO_CHANGE_INTERVAL };
+static const report_config_t humidity_report_config = { "humidity", 1.0f, 3.0f, VALUE_PUB_MIN_INTERVAL, HUMIDITY_TAG_PUB_NO_CHANGE_INTEVAL };
+
+// Update intervals of the tags, from the interval of a changing value to the longest one of a steady value
+static const sampling_config_t temperature_sampling_config = { "temperature tag", 5000, 2 * MINUTE };
+static const sampling_config_t humidity_sampling_config = { "humidity tag", 5000, 2 * MINUTE };
 
 twr_module_pir_t pirModule;
 
 twr_scheduler_task_id_t noMovementTaskId;
 
 twr_tag_temperature_t temperatureTag;
-float temperature;
-twr_tick_t nextTemperaturePublish;
+report_t temperature_report;
+sampling_t temperature_sampling;
 
-float co2Concentration;
-twr_tick_t nextCO2Publish;
+report_t co2_report;
 
 twr_tag_humidity_t humidityTag;
-float humidity;
-twr_tick_t nextHumidityPublish;
+report_t humidity_report;
+sampling_t humidity_sampling;
 
 bool movement = false;
 
@@ -98,11 +108,9 @@ void co2_event_handler(twr_module_co2_event_t event, void *event_param)
         float ppm;
         twr_module_co2_get_concentration_ppm(&ppm);
 
-        if ((fabs(ppm - co2Concentration) >= CO2_CHANGE_PUB_TRESHOLD) || (nextCO2Publish < twr_scheduler_get_spin_tick()))
+        if (report_update(&co2_report, ppm))
         {
             twr_radio_pub_co2(&ppm);
-            co2Concentration = ppm;
-            nextCO2Publish = twr_scheduler_get_spin_tick() + CO2_PUB_NO_CHANGE_INTERVAL;
         }
     }
 }
@@ -122,11 +130,14 @@ void humidity_tag_event_handler(twr_tag_humidity_t *self, twr_tag_humidity_event
         float percentage;
         twr_tag_humidity_get_humidity_percentage(self, &percentage);
 
-        if ((fabs(percentage - humidity) >= HUMIDITY_VALUE_CHANGE_PUB_TRESHOLD) || (nextHumidityPublish < twr_scheduler_get_spin_tick()))
+        if (report_update(&humidity_report, percentage))
         {
             twr_radio_pub_humidity(TWR_RADIO_PUB_CHANNEL_R1_I2C0_ADDRESS_DEFAULT, &percentage);
-            humidity = percentage;
-            nextHumidityPublish = twr_scheduler_get_spin_tick() + HUMIDITY_TAG_PUB_NO_CHANGE_INTEVAL;
+        }
+
+        if (sampling_update(&humidity_sampling, percentage, report_get_deadband(&humidity_report)))
+        {
+            twr_tag_humidity_set_update_interval(self, sampling_get_interval(&humidity_sampling));
         }
     }
 }
@@ -145,12 +156,15 @@ void temperature_tag_event_handler(twr_tag_temperature_t *self, twr_tag_temperat
         twr_tag_temperature_get_temperature_celsius(self, &celsius);
 
         // Read temperature
-        if ((fabs(celsius - temperature) >= VALUE_CHANGE_PUB_TRESHOLD) || (nextTemperaturePublish < twr_scheduler_get_spin_tick()))
+        if (report_update(&temperature_report, celsius))
         {
             twr_log_debug("APP: temperature: %.2f °C", celsius);
             twr_radio_pub_temperature(TWR_RADIO_PUB_CHANNEL_R1_I2C0_ADDRESS_DEFAULT, &celsius);
-            temperature = celsius;
-            nextTemperaturePublish = twr_scheduler_get_spin_tick() + TEMPERATURE_TAG_PUB_NO_CHANGE_INTEVAL;
+        }
+
+        if (sampling_update(&temperature_sampling, celsius, report_get_deadband(&temperature_report)))
+        {
+            twr_tag_temperature_set_update_interval(self, sampling_get_interval(&temperature_sampling));
         }
     }
 }
@@ -171,15 +185,22 @@ void application_init(void)
 {
     twr_log_init(TWR_LOG_LEVEL_DUMP, TWR_LOG_TIMESTAMP_REL);
 
+    report_init(&temperature_report, &temperature_report_config);
+    report_init(&co2_report, &co2_report_config);
+    report_init(&humidity_report, &humidity_report_config);
+
+    sampling_init(&temperature_sampling, &temperature_sampling_config);
+    sampling_init(&humidity_sampling, &humidity_sampling_config);
+
     // Temperature sensor inicialization
     twr_tag_temperature_init(&temperatureTag, TWR_I2C_I2C0, TWR_TAG_TEMPERATURE_I2C_ADDRESS_DEFAULT);
     twr_tag_temperature_set_event_handler(&temperatureTag, temperature_tag_event_handler, NULL);
-    twr_tag_temperature_set_update_interval(&temperatureTag, 5000);
+    twr_tag_temperature_set_update_interval(&temperatureTag, sampling_get_interval(&temperature_sampling));
 
     // Humidity sensor inicialization
     twr_tag_humidity_init(&humidityTag, TWR_TAG_HUMIDITY_REVISION_R2, TWR_I2C_I2C0, TWR_TAG_HUMIDITY_I2C_ADDRESS_DEFAULT);
     twr_tag_humidity_set_event_handler(&humidityTag, humidity_tag_event_handler, NULL);
-    twr_tag_humidity_set_update_interval(&humidityTag, 5000);
+    twr_tag_humidity_set_update_interval(&humidityTag, sampling_get_interval(&humidity_sampling));
 
     // CO2 module inicialization
     twr_module_co2_init();
@@ -7,9 +7,15 @@ Date: 2.4.2021
 */
 
 #include <application.h>
+#include <report.h>
+#include <sampling.h>
 
+#define TEMPERATURE_TAG_PUB_MIN_INTERVAL (30 * 1000)
 #define TEMPERATURE_TAG_PUB_NO_CHANGE_INTEVAL (15 * MINUTE)
-#define VALUE_CHANGE_PUB_TRESHOLD 0.2f
+
+// Update interval of the temperature while it changes and the longest one while it is steady
+#define TEMPERATURE_TAG_UPDATE_MIN_INTERVAL (5 * 1000)
+#define TEMPERATURE_TAG_UPDATE_MAX_INTERVAL (2 * MINUTE)
 
 #define NO_MOVEMENT_DETECTED_INTERVAL (MINUTE)
 
@@ -21,8 +27,11 @@ twr_module_pir_t pirModule;
 
 twr_scheduler_task_id_t noMovementTaskId;
 
-float temperature;
-twr_tick_t nextTemperaturePublish;
+static const report_config_t temperature_report_config = { "temperature", 0.2f, 0.6f, TEMPERATURE_TAG_PUB_MIN_INTERVAL, TEMPERATURE_TAG_PUB_NO_CHANGE_INTEVAL };
+static const sampling_config_t temperature_sampling_config = { "tmp112", TEMPERATURE_TAG_UPDATE_MIN_INTERVAL, TEMPERATURE_TAG_UPDATE_MAX_INTERVAL };
+
+report_t temperature_report;
+sampling_t temperature_sampling;
 
 bool movement = false;
 
@@ -85,12 +94,15 @@ void tmp112_event_handler(twr_tmp112_t *self, twr_tmp112_event_t event, void *ev
         float celsius;
         twr_tmp112_get_temperature_celsius(self, &celsius);
 
-        if ((fabs(celsius - temperature) >= VALUE_CHANGE_PUB_TRESHOLD) || (nextTemperaturePublish < twr_scheduler_get_spin_tick()))
+        if (report_update(&temperature_report, celsius))
         {
             twr_log_debug("APP: temperature: %.2f °C", celsius);
             twr_radio_pub_temperature(TWR_RADIO_PUB_CHANNEL_R1_I2C0_ADDRESS_ALTERNATE, &celsius);
-            temperature = celsius;
-            nextTemperaturePublish = twr_scheduler_get_spin_tick() + TEMPERATURE_TAG_PUB_NO_CHANGE_INTEVAL;
+        }
+
+        if (sampling_update(&temperature_sampling, celsius, report_get_deadband(&temperature_report)))
+        {
+            twr_tmp112_set_update_interval(self, sampling_get_interval(&temperature_sampling));
         }
     }
 }
@@ -111,10 +123,13 @@ void application_init(void)
 {
     twr_log_init(TWR_LOG_LEVEL_DUMP, TWR_LOG_TIMESTAMP_REL);
 
+    report_init(&temperature_report, &temperature_report_config);
+    sampling_init(&temperature_sampling, &temperature_sampling_config);
+
     // Temperature sensor inicialization
     twr_tmp112_init(&tmp112, TWR_I2C_I2C0, 0x49);
     twr_tmp112_set_event_handler(&tmp112, tmp112_event_handler, NULL);
-    twr_tmp112_set_update_interval(&tmp112, 5000);
+    twr_tmp112_set_update_interval(&tmp112, sampling_get_interval(&temperature_sampling));
 
     // PIR module inicialization
     twr_module_pir_init(&pirModule);
@@ -0,0 +1,1256 @@
+/*
+Headless LCD simulator, it runs the firmware on the host and renders its pages
+
+lcdsim [-d <dir>] [-e <eeprom file>] [-v] [script]
+
+The firmware sources are built against the host SDK in sdk/. application_init runs first, then the script, or the
+standard input, drives the scheduler in virtual milliseconds and feeds the firmware with sensor values, button events
+and radio messages, one command per line:
+
+run <ms>                 runs the planned tasks for the given time
+temp <celsius>|error     sets what the following temperature measurements return
+click left|right         button click on the LCD module
+hold left|right          button hold on the LCD module
+sub <topic> <value>      radio message on a subscribed topic
+qr [text]                checks the QR code text of the firmware, without spaces, none for a symbol received as a bitmap
+dump <file.pbm>          writes what the display shows
+stats                    prints the totals
+
+Every frame, that is the drawing into the framebuffer together with the SPI transfers that send it to the display, is
+printed as one line: the gfx primitives, the pixels drawn through the driver, the framebuffer pixels that changed, the
+display lines and bytes sent, and the host time spent in the firmware. The display image is decoded from the SPI data
+like the memory LCD does it, so it shows what a line-level update really sent. Lines that still differ from the
+framebuffer at the end of a frame and malformed transfers are counted as errors, and lcdsim then exits with 1.
+
+With -d every frame is also dumped as <dir>/frame-NNNN.pbm. With -e the EEPROM is loaded from the file and saved back at
+the end, so the next run starts like the device after a reset. -v prints the log of the firmware.
+*/
+
+#include <time.h>
+
+#include <twr.h>
+
+#define LCDSIM_TASK_COUNT 32
+#define LCDSIM_EEPROM_SIZE 6144
+#define LCDSIM_RUNS_PER_TICK_MAX 100000
+
+// Display line in the framebuffer of the ls013b7dh03 driver: address byte, 128 pixels in 16 bytes and dummy byte, behind the mode byte
+#define LCDSIM_LINES TWR_LS013B7DH03_HEIGHT
+#define LCDSIM_LINE_BYTES (TWR_LS013B7DH03_WIDTH / 8)
+#define LCDSIM_LINE_STRIDE (LCDSIM_LINE_BYTES + 2)
+#define LCDSIM_LINE_OFFSET(y) (2 + (y) * LCDSIM_LINE_STRIDE)
+
+// SPI clock of the display in bits per millisecond
+#define LCDSIM_SPI_BITS_PER_MS 1000
+
+void application_init(void);
+void application_task(void);
+
+// QR code text of the firmware, loaded from the EEPROM at boot
+extern char qr_code[];
+
+const uint8_t *lcdsim_font_get(uint8_t ch);
+
+// Counters of one frame and of the whole run
+typedef struct
+{
+    int clears;
+    int strings;
+    int chars;
+    int rectangles;
+    long pixels_drawn;
+    long pixels_changed;
+    int updates;
+    int transfers;
+    int lines;
+    long bytes;
+    long cpu_ns;
+} lcdsim_counters_t;
+
+static struct
+{
+    void (*task)(void *);
+    void *param;
+    twr_tick_t tick;
+} lcdsim_tasks[LCDSIM_TASK_COUNT];
+
+static size_t lcdsim_task_count;
+static twr_scheduler_task_id_t lcdsim_current_task;
+static twr_tick_t lcdsim_now;
+
+static twr_ls013b7dh03_t lcdsim_lcd;
+static twr_gfx_t lcdsim_gfx;
+static void (*lcdsim_lcd_event_handler)(twr_module_lcd_event_t, void *);
+static void *lcdsim_lcd_event_param;
+
+// What the display shows, and the framebuffer lines at the start of the frame
+static uint8_t lcdsim_panel[LCDSIM_LINES][LCDSIM_LINE_BYTES];
+static uint8_t lcdsim_frame_start[LCDSIM_LINES][LCDSIM_LINE_BYTES];
+
+static struct
+{
+    bool busy;
+    twr_scheduler_task_id_t task_id;
+    void (*event_handler)(twr_spi_event_t, void *);
+    void *event_param;
+} lcdsim_spi;
+
+static lcdsim_counters_t lcdsim_frame;
+static lcdsim_counters_t lcdsim_total;
+static int lcdsim_frame_count;
+static int lcdsim_errors;
+
+// VCOM bit of the last transfer, it has to alternate or the panel gets a DC bias
+static int lcdsim_vcom = -1;
+static const char *lcdsim_dump_dir;
+
+static uint8_t lcdsim_eeprom[LCDSIM_EEPROM_SIZE];
+
+static twr_radio_sub_t *lcdsim_subs;
+static int lcdsim_sub_count;
+
+static float lcdsim_temperature = 22.5f;
+static bool lcdsim_temperature_valid = true;
+static twr_tmp112_t *lcdsim_tmp112;
+
+static void (*lcdsim_battery_event_handler)(twr_module_battery_event_t, void *);
+static void *lcdsim_battery_event_param;
+static twr_scheduler_task_id_t lcdsim_battery_task_id;
+static twr_tick_t lcdsim_battery_interval = TWR_TICK_INFINITY;
+
+static bool lcdsim_verbose;
+
+static long lcdsim_time_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (long) now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+// Scheduler
+
+twr_tick_t twr_tick_get(void)
+{
+    return lcdsim_now;
+}
+
+twr_tick_t twr_scheduler_get_spin_tick(void)
+{
+    return lcdsim_now;
+}
+
+twr_scheduler_task_id_t twr_scheduler_register(void (*task)(void *), void *param, twr_tick_t tick)
+{
+    for (twr_scheduler_task_id_t i = 0; i < LCDSIM_TASK_COUNT; i++)
+    {
+        if (lcdsim_tasks[i].task == NULL)
+        {
+            lcdsim_tasks[i].task = task;
+            lcdsim_tasks[i].param = param;
+            lcdsim_tasks[i].tick = tick;
+
+            if (i >= lcdsim_task_count)
+            {
+                lcdsim_task_count = i + 1;
+            }
+
+            return i;
+        }
+    }
+
+    fprintf(stderr, "lcdsim: too many tasks\n");
+    exit(2);
+}
+
+void twr_scheduler_unregister(twr_scheduler_task_id_t task_id)
+{
+    lcdsim_tasks[task_id].task = NULL;
+}
+
+twr_scheduler_task_id_t twr_scheduler_get_current_task_id(void)
+{
+    return lcdsim_current_task;
+}
+
+void twr_scheduler_plan_now(twr_scheduler_task_id_t task_id)
+{
+    lcdsim_tasks[task_id].tick = lcdsim_now;
+}
+
+void twr_scheduler_plan_absolute(twr_scheduler_task_id_t task_id, twr_tick_t tick)
+{
+    lcdsim_tasks[task_id].tick = tick;
+}
+
+void twr_scheduler_plan_relative(twr_scheduler_task_id_t task_id, twr_tick_t tick)
+{
+    lcdsim_tasks[task_id].tick = lcdsim_now + tick;
+}
+
+void twr_scheduler_plan_current_now(void)
+{
+    twr_scheduler_plan_now(lcdsim_current_task);
+}
+
+void twr_scheduler_plan_current_absolute(twr_tick_t tick)
+{
+    twr_scheduler_plan_absolute(lcdsim_current_task, tick);
+}
+
+void twr_scheduler_plan_current_relative(twr_tick_t tick)
+{
+    twr_scheduler_plan_relative(lcdsim_current_task, tick);
+}
+
+// System, EEPROM and log
+
+void twr_system_pll_enable(void)
+{
+}
+
+void twr_system_pll_disable(void)
+{
+}
+
+bool twr_eeprom_write(uint32_t address, const void *buffer, size_t length)
+{
+    if (address + length > sizeof(lcdsim_eeprom))
+    {
+        return false;
+    }
+
+    memcpy(&lcdsim_eeprom[address], buffer, length);
+
+    return true;
+}
+
+bool twr_eeprom_read(uint32_t address, void *buffer, size_t length)
+{
+    if (address + length > sizeof(lcdsim_eeprom))
+    {
+        return false;
+    }
+
+    memcpy(buffer, &lcdsim_eeprom[address], length);
+
+    return true;
+}
+
+size_t twr_eeprom_get_size(void)
+{
+    return sizeof(lcdsim_eeprom);
+}
+
+static void lcdsim_log(char level, const char *format, va_list ap)
+{
+    printf("# %llu <%c> ", (unsigned long long) lcdsim_now, level);
+    vprintf(format, ap);
+    printf("\n");
+}
+
+void twr_log_init(twr_log_level_t level, twr_log_timestamp_t timestamp)
+{
+}
+
+void twr_log_debug(const char *format, ...)
+{
+    va_list ap;
+
+    if (lcdsim_verbose)
+    {
+        va_start(ap, format);
+        lcdsim_log('D', format, ap);
+        va_end(ap);
+    }
+}
+
+void twr_log_info(const char *format, ...)
+{
+    va_list ap;
+
+    if (lcdsim_verbose)
+    {
+        va_start(ap, format);
+        lcdsim_log('I', format, ap);
+        va_end(ap);
+    }
+}
+
+void twr_log_warning(const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    lcdsim_log('W', format, ap);
+    va_end(ap);
+}
+
+void twr_log_error(const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    lcdsim_log('E', format, ap);
+    va_end(ap);
+}
+
+// Radio, the published values are printed
+
+void twr_radio_init(twr_radio_mode_t mode)
+{
+}
+
+void twr_radio_set_subs(twr_radio_sub_t *subs, int length)
+{
+    lcdsim_subs = subs;
+    lcdsim_sub_count = length;
+}
+
+void twr_radio_set_rx_timeout_for_sleeping_node(twr_tick_t timeout)
+{
+}
+
+void twr_radio_pairing_request(const char *firmware, const char *version)
+{
+    printf("%llu ms: pairing %s %s\n", (unsigned long long) lcdsim_now, firmware, version);
+}
+
+bool twr_radio_pub_temperature(uint8_t channel, float *celsius)
+{
+    printf("%llu ms: pub temperature %u %.2f\n", (unsigned long long) lcdsim_now, channel, *celsius);
+
+    return true;
+}
+
+bool twr_radio_pub_battery(float *voltage)
+{
+    printf("%llu ms: pub battery %.2f\n", (unsigned long long) lcdsim_now, *voltage);
+
+    return true;
+}
+
+bool twr_radio_pub_push_button(uint16_t *event_count)
+{
+    printf("%llu ms: pub push-button %d\n", (unsigned long long) lcdsim_now, event_count != NULL ? *event_count : -1);
+
+    return true;
+}
+
+bool twr_radio_pub_int(const char *subtopic, int *value)
+{
+    printf("%llu ms: pub %s %d\n", (unsigned long long) lcdsim_now, subtopic, *value);
+
+    return true;
+}
+
+bool twr_radio_pub_float(const char *subtopic, float *value)
+{
+    printf("%llu ms: pub %s %.2f\n", (unsigned long long) lcdsim_now, subtopic, *value);
+
+    return true;
+}
+
+bool twr_radio_pub_bool(const char *subtopic, bool *value)
+{
+    printf("%llu ms: pub %s %s\n", (unsigned long long) lcdsim_now, subtopic, *value ? "true" : "false");
+
+    return true;
+}
+
+bool twr_radio_pub_string(const char *subtopic, const char *value)
+{
+    printf("%llu ms: pub %s \"%s\"\n", (unsigned long long) lcdsim_now, subtopic, value);
+
+    return true;
+}
+
+bool twr_radio_pub_buffer(void *buffer, size_t length)
+{
+    printf("%llu ms: pub buffer", (unsigned long long) lcdsim_now);
+
+    for (size_t i = 0; i < length; i++)
+    {
+        printf(" %02x", ((uint8_t *) buffer)[i]);
+    }
+
+    printf("\n");
+
+    return true;
+}
+
+// Temperature tag and battery module, they report at their update intervals
+
+static void lcdsim_tmp112_task(void *param)
+{
+    twr_tmp112_t *self = param;
+
+    if (self->_event_handler != NULL)
+    {
+        self->_event_handler(self, lcdsim_temperature_valid ? TWR_TMP112_EVENT_UPDATE : TWR_TMP112_EVENT_ERROR, self->_event_param);
+    }
+
+    if (self->_update_interval != TWR_TICK_INFINITY)
+    {
+        twr_scheduler_plan_current_relative(self->_update_interval);
+    }
+}
+
+void twr_tmp112_init(twr_tmp112_t *self, twr_i2c_channel_t i2c_channel, uint8_t i2c_address)
+{
+    memset(self, 0, sizeof(*self));
+
+    self->_update_interval = TWR_TICK_INFINITY;
+    self->_task_id = twr_scheduler_register(lcdsim_tmp112_task, self, TWR_TICK_INFINITY);
+
+    lcdsim_tmp112 = self;
+}
+
+void twr_tmp112_set_event_handler(twr_tmp112_t *self, void (*event_handler)(twr_tmp112_t *, twr_tmp112_event_t, void *), void *event_param)
+{
+    self->_event_handler = event_handler;
+    self->_event_param = event_param;
+}
+
+void twr_tmp112_set_update_interval(twr_tmp112_t *self, twr_tick_t interval)
+{
+    self->_update_interval = interval;
+
+    twr_scheduler_plan_now(self->_task_id);
+}
+
+bool twr_tmp112_get_temperature_celsius(twr_tmp112_t *self, float *celsius)
+{
+    *celsius = lcdsim_temperature;
+
+    return lcdsim_temperature_valid;
+}
+
+static void lcdsim_battery_task(void *param)
+{
+    if (lcdsim_battery_event_handler != NULL)
+    {
+        lcdsim_battery_event_handler(TWR_MODULE_BATTERY_EVENT_UPDATE, lcdsim_battery_event_param);
+    }
+
+    if (lcdsim_battery_interval != TWR_TICK_INFINITY)
+    {
+        twr_scheduler_plan_current_relative(lcdsim_battery_interval);
+    }
+}
+
+void twr_module_battery_init(void)
+{
+    lcdsim_battery_task_id = twr_scheduler_register(lcdsim_battery_task, NULL, TWR_TICK_INFINITY);
+}
+
+void twr_module_battery_set_event_handler(void (*event_handler)(twr_module_battery_event_t, void *), void *event_param)
+{
+    lcdsim_battery_event_handler = event_handler;
+    lcdsim_battery_event_param = event_param;
+}
+
+void twr_module_battery_set_update_interval(twr_tick_t interval)
+{
+    lcdsim_battery_interval = interval;
+
+    twr_scheduler_plan_now(lcdsim_battery_task_id);
+}
+
+bool twr_module_battery_get_voltage(float *voltage)
+{
+    *voltage = 3.0f;
+
+    return true;
+}
+
+bool twr_module_battery_get_charge_level(int *percentage)
+{
+    *percentage = 100;
+
+    return true;
+}
+
+// SPI, a transfer takes the time of its bits at 1 MHz and the display takes the data when it starts
+
+static uint8_t lcdsim_reverse(uint8_t byte)
+{
+    uint8_t reversed = 0;
+
+    for (int i = 0; i < 8; i++, byte >>= 1)
+    {
+        reversed = (reversed << 1) | (byte & 1);
+    }
+
+    return reversed;
+}
+
+/*
+This function will write the lines of a transfer to the display like the memory LCD does
+
+The transfer is the mode byte with the write bit and the VCOM bit, then every line as its address with the least significant
+bit first, 16 data bytes and a dummy byte, and a trailing dummy byte. The VCOM bit has to differ from the previous transfer.
+*/
+static void lcdsim_panel_receive(const uint8_t *data, size_t length)
+{
+    size_t i = 1;
+
+    if (length < 2 || (data[0] & 0x80) == 0)
+    {
+        lcdsim_errors++;
+
+        return;
+    }
+
+    if ((data[0] & 0x40) == lcdsim_vcom)
+    {
+        fprintf(stderr, "lcdsim: VCOM bit did not alternate\n");
+        lcdsim_errors++;
+    }
+
+    lcdsim_vcom = data[0] & 0x40;
+
+    for (; i + LCDSIM_LINE_STRIDE < length; i += LCDSIM_LINE_STRIDE)
+    {
+        int line = lcdsim_reverse(data[i]) - 1;
+
+        if (line < 0 || line >= LCDSIM_LINES)
+        {
+            lcdsim_errors++;
+
+            return;
+        }
+
+        memcpy(lcdsim_panel[line], &data[i + 1], LCDSIM_LINE_BYTES);
+        lcdsim_frame.lines++;
+    }
+
+    if (i != length - 1)
+    {
+        lcdsim_errors++;
+    }
+}
+
+static void lcdsim_spi_task(void *param)
+{
+    lcdsim_spi.busy = false;
+
+    if (lcdsim_spi.event_handler != NULL)
+    {
+        lcdsim_spi.event_handler(TWR_SPI_EVENT_DONE, lcdsim_spi.event_param);
+    }
+}
+
+bool twr_spi_is_ready(void)
+{
+    return !lcdsim_spi.busy;
+}
+
+void twr_spi_set_speed(twr_spi_speed_t speed)
+{
+}
+
+void twr_spi_set_mode(twr_spi_mode_t mode)
+{
+}
+
+bool twr_spi_async_transfer(const void *source, void *destination, size_t length, void (*event_handler)(twr_spi_event_t, void *), void *event_param)
+{
+    if (lcdsim_spi.busy)
+    {
+        return false;
+    }
+
+    lcdsim_panel_receive(source, length);
+
+    lcdsim_frame.transfers++;
+    lcdsim_frame.bytes += length;
+
+    lcdsim_spi.busy = true;
+    lcdsim_spi.event_handler = event_handler;
+    lcdsim_spi.event_param = event_param;
+
+    twr_scheduler_plan_relative(lcdsim_spi.task_id, (length * 8 + LCDSIM_SPI_BITS_PER_MS - 1) / LCDSIM_SPI_BITS_PER_MS);
+
+    return true;
+}
+
+// Memory LCD driver with the framebuffer layout of the SDK, a white pixel is 1
+
+static bool lcdsim_lcd_pin_cs_set(bool state)
+{
+    return true;
+}
+
+static bool lcdsim_lcd_is_ready(void *self)
+{
+    return twr_spi_is_ready();
+}
+
+static void lcdsim_lcd_clear(void *self)
+{
+    twr_ls013b7dh03_t *lcd = self;
+
+    for (int y = 0; y < LCDSIM_LINES; y++)
+    {
+        memset(&lcd->_framebuffer[LCDSIM_LINE_OFFSET(y)], 0xff, LCDSIM_LINE_BYTES);
+    }
+
+    lcdsim_frame.pixels_drawn += TWR_LS013B7DH03_WIDTH * TWR_LS013B7DH03_HEIGHT;
+}
+
+static void lcdsim_lcd_draw_pixel(void *self, int left, int top, uint32_t color)
+{
+    twr_ls013b7dh03_t *lcd = self;
+
+    if (left < 0 || left >= TWR_LS013B7DH03_WIDTH || top < 0 || top >= TWR_LS013B7DH03_HEIGHT)
+    {
+        return;
+    }
+
+    uint8_t *byte = &lcd->_framebuffer[LCDSIM_LINE_OFFSET(top) + left / 8];
+
+    if (color)
+    {
+        *byte &= ~(0x80 >> (left % 8));
+    }
+    else
+    {
+        *byte |= 0x80 >> (left % 8);
+    }
+
+    lcdsim_frame.pixels_drawn++;
+}
+
+static uint32_t lcdsim_lcd_get_pixel(void *self, int left, int top)
+{
+    twr_ls013b7dh03_t *lcd = self;
+
+    if (left < 0 || left >= TWR_LS013B7DH03_WIDTH || top < 0 || top >= TWR_LS013B7DH03_HEIGHT)
+    {
+        return 0;
+    }
+
+    return (lcd->_framebuffer[LCDSIM_LINE_OFFSET(top) + left / 8] & (0x80 >> (left % 8))) == 0;
+}
+
+static void lcdsim_lcd_spi_event_handler(twr_spi_event_t event, void *event_param)
+{
+    lcdsim_lcd._pin_cs_set(0);
+}
+
+static bool lcdsim_lcd_update(void *self)
+{
+    twr_ls013b7dh03_t *lcd = self;
+
+    if (!twr_spi_is_ready() || !lcd->_pin_cs_set(1))
+    {
+        return false;
+    }
+
+    lcd->_framebuffer[0] = 0x80 | lcd->_vcom;
+    lcd->_vcom ^= 0x40;
+
+    lcdsim_frame.updates++;
+
+    return twr_spi_async_transfer(lcd->_framebuffer, NULL, sizeof(lcd->_framebuffer), lcdsim_lcd_spi_event_handler, NULL);
+}
+
+static twr_gfx_caps_t lcdsim_lcd_get_caps(void *self)
+{
+    return (twr_gfx_caps_t) { .width = TWR_LS013B7DH03_WIDTH, .height = TWR_LS013B7DH03_HEIGHT };
+}
+
+static const twr_gfx_driver_t lcdsim_lcd_driver = {
+    .is_ready = lcdsim_lcd_is_ready,
+    .clear = lcdsim_lcd_clear,
+    .draw_pixel = lcdsim_lcd_draw_pixel,
+    .get_pixel = lcdsim_lcd_get_pixel,
+    .update = lcdsim_lcd_update,
+    .get_caps = lcdsim_lcd_get_caps
+};
+
+void twr_module_lcd_init(void)
+{
+    memset(&lcdsim_lcd, 0, sizeof(lcdsim_lcd));
+
+    lcdsim_lcd._pin_cs_set = lcdsim_lcd_pin_cs_set;
+    lcdsim_lcd._framebuffer[0] = 0x80;
+
+    for (int y = 0; y < LCDSIM_LINES; y++)
+    {
+        lcdsim_lcd._framebuffer[LCDSIM_LINE_OFFSET(y) - 1] = lcdsim_reverse(y + 1);
+        memset(&lcdsim_lcd._framebuffer[LCDSIM_LINE_OFFSET(y)], 0xff, LCDSIM_LINE_BYTES);
+    }
+
+    lcdsim_gfx._display = &lcdsim_lcd;
+    lcdsim_gfx._driver = &lcdsim_lcd_driver;
+    lcdsim_gfx._caps = lcdsim_lcd_get_caps(&lcdsim_lcd);
+}
+
+twr_gfx_t *twr_module_lcd_get_gfx(void)
+{
+    return &lcdsim_gfx;
+}
+
+bool twr_module_lcd_is_ready(void)
+{
+    return twr_spi_is_ready();
+}
+
+void twr_module_lcd_set_event_handler(void (*event_handler)(twr_module_lcd_event_t, void *), void *event_param)
+{
+    lcdsim_lcd_event_handler = event_handler;
+    lcdsim_lcd_event_param = event_param;
+}
+
+void twr_module_lcd_set_button_hold_time(twr_tick_t hold_time)
+{
+}
+
+// Graphics, drawn pixel by pixel through the driver like the SDK does it
+
+bool twr_gfx_display_is_ready(twr_gfx_t *self)
+{
+    return self->_driver->is_ready(self->_display);
+}
+
+twr_gfx_caps_t twr_gfx_get_caps(twr_gfx_t *self)
+{
+    return self->_caps;
+}
+
+void twr_gfx_clear(twr_gfx_t *self)
+{
+    lcdsim_frame.clears++;
+
+    self->_driver->clear(self->_display);
+}
+
+void twr_gfx_set_font(twr_gfx_t *self, const twr_font_t *font)
+{
+    self->_font = font;
+}
+
+void twr_gfx_draw_pixel(twr_gfx_t *self, int left, int top, uint32_t color)
+{
+    self->_driver->draw_pixel(self->_display, left, top, color);
+}
+
+int twr_gfx_calc_char_width(twr_gfx_t *self, uint8_t ch)
+{
+    if (self->_font == NULL || lcdsim_font_get(ch) == NULL)
+    {
+        return 0;
+    }
+
+    return 6 * self->_font->scale;
+}
+
+/*
+This function will draw the whole box of the character, the glyph in the color and the rest in the opposite color,
+the 7 rows of the glyph are centred in the height of the font
+*/
+int twr_gfx_draw_char(twr_gfx_t *self, int left, int top, uint8_t ch, uint32_t color)
+{
+    const uint8_t *columns = lcdsim_font_get(ch);
+    int width = twr_gfx_calc_char_width(self, ch);
+
+    if (width == 0)
+    {
+        return 0;
+    }
+
+    int scale = self->_font->scale;
+    int offset = (self->_font->height - 7 * scale) / 2;
+
+    lcdsim_frame.chars++;
+
+    for (int y = 0; y < self->_font->height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int row = (y - offset) / scale;
+            int column = x / scale;
+            bool set = y >= offset && row < 7 && column < 5 && (columns[column] & (1 << row)) != 0;
+
+            self->_driver->draw_pixel(self->_display, left + x, top + y, set ? color : !color);
+        }
+    }
+
+    return width;
+}
+
+int twr_gfx_calc_string_width(twr_gfx_t *self, char *str)
+{
+    int width = 0;
+
+    for (; *str != '\0'; str++)
+    {
+        width += twr_gfx_calc_char_width(self, (uint8_t) *str);
+    }
+
+    return width;
+}
+
+int twr_gfx_draw_string(twr_gfx_t *self, int left, int top, char *str, uint32_t color)
+{
+    lcdsim_frame.strings++;
+
+    for (; *str != '\0'; str++)
+    {
+        left += twr_gfx_draw_char(self, left, top, (uint8_t) *str, color);
+    }
+
+    return left;
+}
+
+void twr_gfx_draw_fill_rectangle(twr_gfx_t *self, int x0, int y0, int x1, int y1, uint32_t color)
+{
+    int swap;
+
+    if (x0 > x1)
+    {
+        swap = x0, x0 = x1, x1 = swap;
+    }
+
+    if (y0 > y1)
+    {
+        swap = y0, y0 = y1, y1 = swap;
+    }
+
+    lcdsim_frame.rectangles++;
+
+    for (int y = y0; y <= y1; y++)
+    {
+        for (int x = x0; x <= x1; x++)
+        {
+            self->_driver->draw_pixel(self->_display, x, y, color);
+        }
+    }
+}
+
+bool twr_gfx_update(twr_gfx_t *self)
+{
+    return self->_driver->update(self->_display);
+}
+
+// Frames
+
+static void lcdsim_write_pbm(const char *path, const uint8_t lines[LCDSIM_LINES][LCDSIM_LINE_BYTES])
+{
+    FILE *file = fopen(path, "wb");
+
+    if (file == NULL)
+    {
+        perror(path);
+        lcdsim_errors++;
+
+        return;
+    }
+
+    // PBM has black as 1, the display has white as 1
+    fprintf(file, "P4\n%d %d\n", TWR_LS013B7DH03_WIDTH, LCDSIM_LINES);
+
+    for (int y = 0; y < LCDSIM_LINES; y++)
+    {
+        for (int i = 0; i < LCDSIM_LINE_BYTES; i++)
+        {
+            fputc((uint8_t) ~lines[y][i], file);
+        }
+    }
+
+    fclose(file);
+}
+
+static void lcdsim_counters_add(lcdsim_counters_t *total, const lcdsim_counters_t *frame)
+{
+    total->clears += frame->clears;
+    total->strings += frame->strings;
+    total->chars += frame->chars;
+    total->rectangles += frame->rectangles;
+    total->pixels_drawn += frame->pixels_drawn;
+    total->pixels_changed += frame->pixels_changed;
+    total->updates += frame->updates;
+    total->transfers += frame->transfers;
+    total->lines += frame->lines;
+    total->bytes += frame->bytes;
+    total->cpu_ns += frame->cpu_ns;
+}
+
+/*
+This function will end the frame once its transfers are done, or right away with a label like after the init
+
+The frame is everything the firmware did since the end of the previous frame, the pixels changed are counted against the
+framebuffer at that point
+*/
+static void lcdsim_frame_end(const char *label)
+{
+    const uint8_t *framebuffer = lcdsim_lcd._framebuffer;
+    int stale = 0;
+
+    if (label == NULL && (lcdsim_frame.transfers == 0 || lcdsim_spi.busy))
+    {
+        return;
+    }
+
+    lcdsim_frame.pixels_changed = 0;
+
+    for (int y = 0; y < LCDSIM_LINES; y++)
+    {
+        const uint8_t *line = &framebuffer[LCDSIM_LINE_OFFSET(y)];
+
+        for (int i = 0; i < LCDSIM_LINE_BYTES; i++)
+        {
+            lcdsim_frame.pixels_changed += __builtin_popcount(line[i] ^ lcdsim_frame_start[y][i]);
+        }
+
+        if (label == NULL && memcmp(line, lcdsim_panel[y], LCDSIM_LINE_BYTES) != 0)
+        {
+            stale++;
+        }
+
+        memcpy(lcdsim_frame_start[y], line, LCDSIM_LINE_BYTES);
+    }
+
+    lcdsim_frame_count++;
+    lcdsim_errors += stale;
+
+    printf("%llu ms: frame %d%s%s: %d clear, %d str, %d chr, %d rect, %ld px drawn, %ld px changed, "
+           "%d lines in %d transfers (%d full), %ld B, %.1f ms SPI, %.1f us CPU",
+           (unsigned long long) lcdsim_now, lcdsim_frame_count, label != NULL ? " " : "", label != NULL ? label : "",
+           lcdsim_frame.clears, lcdsim_frame.strings, lcdsim_frame.chars, lcdsim_frame.rectangles, lcdsim_frame.pixels_drawn,
+           lcdsim_frame.pixels_changed, lcdsim_frame.lines, lcdsim_frame.transfers, lcdsim_frame.updates, lcdsim_frame.bytes,
+           (double) lcdsim_frame.bytes * 8 / LCDSIM_SPI_BITS_PER_MS, lcdsim_frame.cpu_ns / 1000.0);
+
+    if (stale > 0)
+    {
+        printf(", %d stale lines", stale);
+    }
+
+    printf("\n");
+
+    if (lcdsim_dump_dir != NULL && label == NULL)
+    {
+        char path[4096];
+
+        snprintf(path, sizeof(path), "%s/frame-%04d.pbm", lcdsim_dump_dir, lcdsim_frame_count);
+        lcdsim_write_pbm(path, (const uint8_t (*)[LCDSIM_LINE_BYTES]) lcdsim_panel);
+    }
+
+    lcdsim_counters_add(&lcdsim_total, &lcdsim_frame);
+    memset(&lcdsim_frame, 0, sizeof(lcdsim_frame));
+}
+
+/*
+This function will run the task and add the time it took to the frame
+*/
+static void lcdsim_call(twr_scheduler_task_id_t task_id)
+{
+    long start = lcdsim_time_ns();
+
+    lcdsim_current_task = task_id;
+    lcdsim_tasks[task_id].tick = TWR_TICK_INFINITY;
+    lcdsim_tasks[task_id].task(lcdsim_tasks[task_id].param);
+
+    // The SPI task is the driver, not the firmware
+    if (task_id != lcdsim_spi.task_id)
+    {
+        lcdsim_frame.cpu_ns += lcdsim_time_ns() - start;
+    }
+
+    lcdsim_frame_end(NULL);
+}
+
+/*
+This function will run the tasks planned within the given time in the order of their ticks, then the lower task ID first
+*/
+static void lcdsim_run(twr_tick_t duration)
+{
+    twr_tick_t end = lcdsim_now + duration;
+    long runs = 0;
+
+    for (;;)
+    {
+        twr_scheduler_task_id_t next = LCDSIM_TASK_COUNT;
+
+        for (twr_scheduler_task_id_t i = 0; i < lcdsim_task_count; i++)
+        {
+            if (lcdsim_tasks[i].task != NULL && lcdsim_tasks[i].tick <= end && (next == LCDSIM_TASK_COUNT || lcdsim_tasks[i].tick < lcdsim_tasks[next].tick))
+            {
+                next = i;
+            }
+        }
+
+        if (next == LCDSIM_TASK_COUNT)
+        {
+            break;
+        }
+
+        if (lcdsim_tasks[next].tick > lcdsim_now)
+        {
+            lcdsim_now = lcdsim_tasks[next].tick;
+            runs = 0;
+        }
+
+        if (++runs > LCDSIM_RUNS_PER_TICK_MAX)
+        {
+            fprintf(stderr, "lcdsim: task %zu keeps running at %llu ms\n", next, (unsigned long long) lcdsim_now);
+            exit(2);
+        }
+
+        lcdsim_call(next);
+    }
+
+    lcdsim_now = end;
+}
+
+static void lcdsim_application_task(void *param)
+{
+    application_task();
+}
+
+// Script
+
+static void lcdsim_lcd_event(twr_module_lcd_event_t event)
+{
+    long start = lcdsim_time_ns();
+
+    if (lcdsim_lcd_event_handler != NULL)
+    {
+        lcdsim_lcd_event_handler(event, lcdsim_lcd_event_param);
+    }
+
+    lcdsim_frame.cpu_ns += lcdsim_time_ns() - start;
+}
+
+static void lcdsim_radio_message(const char *topic, char *value)
+{
+    for (int i = 0; i < lcdsim_sub_count; i++)
+    {
+        if (strcmp(lcdsim_subs[i].topic, topic) == 0)
+        {
+            uint64_t id = 0;
+            int int_value = atoi(value);
+            float float_value = strtof(value, NULL);
+            bool bool_value = strcmp(value, "true") == 0;
+            void *payload = value;
+            long start = lcdsim_time_ns();
+
+            if (lcdsim_subs[i].type == TWR_RADIO_SUB_PT_INT)
+            {
+                payload = &int_value;
+            }
+            else if (lcdsim_subs[i].type == TWR_RADIO_SUB_PT_FLOAT)
+            {
+                payload = &float_value;
+            }
+            else if (lcdsim_subs[i].type == TWR_RADIO_SUB_PT_BOOL)
+            {
+                payload = &bool_value;
+            }
+
+            lcdsim_subs[i].callback(&id, topic, payload, lcdsim_subs[i].param);
+
+            lcdsim_frame.cpu_ns += lcdsim_time_ns() - start;
+
+            return;
+        }
+    }
+
+    fprintf(stderr, "lcdsim: no subscription of %s\n", topic);
+    lcdsim_errors++;
+}
+
+static void lcdsim_print_stats(void)
+{
+    printf("%llu ms: %d frames: %d clear, %d str, %d chr, %d rect, %ld px drawn, %ld px changed, "
+           "%d lines in %d transfers (%d full), %ld B, %.1f ms SPI, %.1f us CPU, %d errors\n",
+           (unsigned long long) lcdsim_now, lcdsim_frame_count, lcdsim_total.clears, lcdsim_total.strings, lcdsim_total.chars,
+           lcdsim_total.rectangles, lcdsim_total.pixels_drawn, lcdsim_total.pixels_changed, lcdsim_total.lines,
+           lcdsim_total.transfers, lcdsim_total.updates, lcdsim_total.bytes, (double) lcdsim_total.bytes * 8 / LCDSIM_SPI_BITS_PER_MS,
+           lcdsim_total.cpu_ns / 1000.0, lcdsim_errors);
+}
+
+/*
+This function will run one line of the script, it returns false for an unknown command
+*/
+static bool lcdsim_command(char *line)
+{
+    char *command = strtok(line, " \t\r\n");
+    char *argument = strtok(NULL, " \t\r\n");
+
+    if (command == NULL || command[0] == '#')
+    {
+        return true;
+    }
+
+    if (strcmp(command, "run") == 0 && argument != NULL)
+    {
+        lcdsim_run(strtoull(argument, NULL, 10));
+    }
+    else if (strcmp(command, "temp") == 0 && argument != NULL)
+    {
+        lcdsim_temperature_valid = strcmp(argument, "error") != 0;
+        lcdsim_temperature = strtof(argument, NULL);
+    }
+    else if ((strcmp(command, "click") == 0 || strcmp(command, "hold") == 0) && argument != NULL)
+    {
+        bool left = strcmp(argument, "left") == 0;
+
+        if (!left && strcmp(argument, "right") != 0)
+        {
+            return false;
+        }
+
+        if (command[0] == 'c')
+        {
+            lcdsim_lcd_event(left ? TWR_MODULE_LCD_EVENT_LEFT_CLICK : TWR_MODULE_LCD_EVENT_RIGHT_CLICK);
+        }
+        else
+        {
+            lcdsim_lcd_event(left ? TWR_MODULE_LCD_EVENT_LEFT_HOLD : TWR_MODULE_LCD_EVENT_RIGHT_HOLD);
+        }
+
+        lcdsim_run(0);
+    }
+    else if (strcmp(command, "sub") == 0 && argument != NULL)
+    {
+        char *value = strtok(NULL, "\r\n");
+
+        lcdsim_radio_message(argument, value != NULL ? value : "");
+        lcdsim_run(0);
+    }
+    else if (strcmp(command, "qr") == 0)
+    {
+        const char *expected = argument != NULL ? argument : "";
+
+        if (strcmp(qr_code, expected) != 0)
+        {
+            fprintf(stderr, "lcdsim: QR code text is \"%s\", expected \"%s\"\n", qr_code, expected);
+            lcdsim_errors++;
+        }
+    }
+    else if (strcmp(command, "dump") == 0 && argument != NULL)
+    {
+        lcdsim_write_pbm(argument, (const uint8_t (*)[LCDSIM_LINE_BYTES]) lcdsim_panel);
+    }
+    else if (strcmp(command, "stats") == 0)
+    {
+        lcdsim_print_stats();
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-d <dir>] [-e <eeprom file>] [-v] [script]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *eeprom_path = NULL;
+    FILE *script = stdin;
+    int i = 1;
+
+    for (; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+        {
+            lcdsim_dump_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+        {
+            eeprom_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "-v") == 0)
+        {
+            lcdsim_verbose = true;
+        }
+        else
+        {
+            usage(argv[0]);
+
+            return 2;
+        }
+    }
+
+    if (i + 1 < argc)
+    {
+        usage(argv[0]);
+
+        return 2;
+    }
+
+    if (i < argc && (script = fopen(argv[i], "r")) == NULL)
+    {
+        perror(argv[i]);
+
+        return 2;
+    }
+
+    if (eeprom_path != NULL)
+    {
+        FILE *file = fopen(eeprom_path, "rb");
+
+        if (file != NULL)
+        {
+            size_t length = fread(lcdsim_eeprom, 1, sizeof(lcdsim_eeprom), file);
+
+            fclose(file);
+            printf("0 ms: EEPROM %zu B from %s\n", length, eeprom_path);
+        }
+    }
+
+    // The application task is task 0 and runs right after the init, like in the SDK
+    twr_scheduler_register(lcdsim_application_task, NULL, 0);
+    lcdsim_spi.task_id = twr_scheduler_register(lcdsim_spi_task, NULL, TWR_TICK_INFINITY);
+
+    long start = lcdsim_time_ns();
+
+    application_init();
+
+    lcdsim_frame.cpu_ns += lcdsim_time_ns() - start;
+    lcdsim_frame_end("init");
+
+    char line[1024];
+    int number = 0;
+
+    while (fgets(line, sizeof(line), script) != NULL)
+    {
+        number++;
+
+        if (!lcdsim_command(line))
+        {
+            fprintf(stderr, "lcdsim: line %d: unknown command\n", number);
+
+            return 2;
+        }
+    }
+
+    if (eeprom_path != NULL)
+    {
+        FILE *file = fopen(eeprom_path, "wb");
+
+        if (file == NULL || fwrite(lcdsim_eeprom, 1, sizeof(lcdsim_eeprom), file) != sizeof(lcdsim_eeprom))
+        {
+            perror(eeprom_path);
+            lcdsim_errors++;
+        }
+
+        if (file != NULL)
+        {
+            fclose(file);
+        }
+    }
+
+    lcdsim_print_stats();
+
+    return lcdsim_errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+/*
+Host round trip check of the compound packets of lib/publish_queue
+
+publish_check prints one line per test case: the packet in hex, the topic and the payload the gateway has to publish.
+publish_check.js decodes the packets with the "Compound packet" node of the Node-RED flows and compares them, so make
+check fails when the encoder and the dictionary of the gateway disagree.
+
+The test cases are the edges of the int16 range of every signed topic, the uint16 range of TVOC and the values beyond
+them, which are limited to the range.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <twr.h>
+#include <publish_queue.h>
+
+typedef struct
+{
+    publish_topic_t topic;
+    float value;
+    const char *name;
+    const char *payload;
+} publish_case_t;
+
+static const publish_case_t publish_cases[] =
+{
+    { PUBLISH_TOPIC_TEMPERATURE, 21.5f, "thermometer/0:0/temperature", "21.50" },
+    { PUBLISH_TOPIC_TEMPERATURE, 327.67f, "thermometer/0:0/temperature", "327.67" },
+    { PUBLISH_TOPIC_TEMPERATURE, -327.68f, "thermometer/0:0/temperature", "-327.68" },
+    { PUBLISH_TOPIC_TEMPERATURE, 400.0f, "thermometer/0:0/temperature", "327.67" },
+    { PUBLISH_TOPIC_TEMPERATURE, -400.0f, "thermometer/0:0/temperature", "-327.68" },
+    { PUBLISH_TOPIC_TEMPERATURE_ALTERNATE, -0.01f, "thermometer/0:1/temperature", "-0.01" },
+    { PUBLISH_TOPIC_HUMIDITY, 3276.7f, "hygrometer/0:0/relative-humidity", "3276.7" },
+    { PUBLISH_TOPIC_HUMIDITY, -3276.8f, "hygrometer/0:0/relative-humidity", "-3276.8" },
+    { PUBLISH_TOPIC_ILLUMINANCE, 327670.0f, "lux-meter/0:0/illuminance", "327670" },
+    { PUBLISH_TOPIC_ILLUMINANCE, 1000000.0f, "lux-meter/0:0/illuminance", "327670" },
+    { PUBLISH_TOPIC_PRESSURE, 101325.0f, "barometer/0:0/pressure", "101330" },
+    { PUBLISH_TOPIC_PRESSURE, -327680.0f, "barometer/0:0/pressure", "-327680" },
+    { PUBLISH_TOPIC_CO2, 32767.0f, "co2-meter/-/concentration", "32767" },
+    { PUBLISH_TOPIC_CO2, 40000.0f, "co2-meter/-/concentration", "32767" },
+    { PUBLISH_TOPIC_TVOC, 0.0f, "voc-lp-sensor/0:0/tvoc", "0" },
+    { PUBLISH_TOPIC_TVOC, 32767.0f, "voc-lp-sensor/0:0/tvoc", "32767" },
+    { PUBLISH_TOPIC_TVOC, 32768.0f, "voc-lp-sensor/0:0/tvoc", "32768" },
+    { PUBLISH_TOPIC_TVOC, 60000.0f, "voc-lp-sensor/0:0/tvoc", "60000" },
+    { PUBLISH_TOPIC_TVOC, 65535.0f, "voc-lp-sensor/0:0/tvoc", "65535" },
+    { PUBLISH_TOPIC_TVOC, 70000.0f, "voc-lp-sensor/0:0/tvoc", "65535" },
+    { PUBLISH_TOPIC_TVOC, -5.0f, "voc-lp-sensor/0:0/tvoc", "0" },
+    { PUBLISH_TOPIC_VOLTAGE, 3.0f, "battery/-/voltage", "3.00" },
+    { PUBLISH_TOPIC_PERCENTAGE, 100.0f, "voltage/percentage", "100" },
+};
+
+// The tasks of the queue, the check runs them itself
+static void (*publish_tasks[2])(void *);
+static void *publish_task_params[2];
+static size_t publish_task_count;
+
+// Packet of the current test case
+static uint8_t publish_packet[PUBLISH_QUEUE_PACKET_SIZE];
+static size_t publish_packet_length;
+static int publish_packet_count;
+
+twr_scheduler_task_id_t twr_scheduler_register(void (*task)(void *), void *param, twr_tick_t tick)
+{
+    publish_tasks[publish_task_count] = task;
+    publish_task_params[publish_task_count] = param;
+
+    return publish_task_count++;
+}
+
+void twr_scheduler_plan_relative(twr_scheduler_task_id_t task_id, twr_tick_t tick)
+{
+}
+
+void twr_scheduler_plan_current_relative(twr_tick_t tick)
+{
+}
+
+void twr_log_debug(const char *format, ...)
+{
+}
+
+bool twr_radio_pub_buffer(void *buffer, size_t length)
+{
+    memcpy(publish_packet, buffer, length);
+    publish_packet_length = length;
+    publish_packet_count++;
+
+    return true;
+}
+
+int main(void)
+{
+    publish_queue_t queue;
+    int errors = 0;
+
+    publish_queue_init(&queue, 2000, 15 * 60 * 1000);
+
+    for (size_t i = 0; i < sizeof(publish_cases) / sizeof(publish_cases[0]); i++)
+    {
+        const publish_case_t *test = &publish_cases[i];
+
+        publish_packet_count = 0;
+
+        publish_queue_set(&queue, test->topic, test->value);
+
+        // The window task sends only the waiting value
+        publish_tasks[queue.window_task_id](publish_task_params[queue.window_task_id]);
+
+        if (publish_packet_count != 1 || publish_packet_length != 4)
+        {
+            fprintf(stderr, "publish_check: %s %g sent %d packets\n", test->name, test->value, publish_packet_count);
+            errors++;
+
+            continue;
+        }
+
+        for (size_t j = 0; j < publish_packet_length; j++)
+        {
+            printf("%02x", publish_packet[j]);
+        }
+
+        printf(" %s %s\n", test->name, test->payload);
+    }
+
+    return errors == 0 ? 0 : 1;
+}
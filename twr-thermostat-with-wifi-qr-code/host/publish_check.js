@@ -0,0 +1,45 @@
+/*
+Round trip check of the compound packets, the decoding half
+
+node publish_check.js <publish_check> <flows.json>
+
+Runs the publish_check program and the "Compound packet" function node of the flows on every packet it prints, and
+compares the topic and the payload the node publishes with the expected ones.
+*/
+
+"use strict";
+
+const child_process = require("child_process");
+const fs = require("fs");
+
+const flows = JSON.parse(fs.readFileSync(process.argv[3]));
+const node = flows.find(n => n.type === "function" && n.name === "Compound packet");
+
+if (node === undefined)
+{
+    console.error("publish_check: no Compound packet node in " + process.argv[3]);
+    process.exit(1);
+}
+
+const decode = new Function("msg", node.func);
+
+// Throws when publish_check fails
+const lines = child_process.execFileSync(process.argv[2], { encoding: "utf8" }).split("\n").filter(line => line !== "");
+let errors = 0;
+
+for (const line of lines)
+{
+    const [hex, topic, payload] = line.split(" ");
+    const result = decode({ topic: "node/check/buffer", payload: Buffer.from(hex, "hex") });
+    const messages = result === null ? [] : result[0];
+
+    if (messages.length !== 1 || messages[0].topic !== "node/check/" + topic || messages[0].payload !== payload)
+    {
+        console.error("publish_check: " + hex + " decoded as " + JSON.stringify(messages) + ", expected " + topic + " " + payload);
+        errors++;
+    }
+}
+
+console.log("publish_check: " + lines.length + " packets, " + errors + " errors");
+
+process.exit(errors === 0 && lines.length > 0 ? 0 : 1);
@@ -0,0 +1,117 @@
+/*
+Gateway encoder of the QR code for the thermostat
+
+qr-gateway [-v max version] [-c chunk length] <text>
+
+The text is the output of the "String builder" node in Node-RED, the surrounding quotes are optional. The ';' is appended
+and the symbol is encoded exactly like the thermostat does it, then it is compressed into a bitmap stream and printed as
+base64 parts "<total length>,<offset>:<base64 text>", one per line. Every line is one message for qr/-/chng/bitmap.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <qrcodegen.h>
+#include <qr_bitmap.h>
+
+// Must be the same as QR_CODE_VERSION_MAX of the thermostat
+#define VERSION_MAX_DEFAULT 6
+
+// Base64 characters per part, a multiple of 4 that keeps a part in one radio packet
+#define CHUNK_LENGTH_DEFAULT 32
+
+// Same length as the QR code text of the thermostat
+#define TEXT_LENGTH_MAX 149
+
+static uint8_t qrcode[qrcodegen_BUFFER_LEN_MAX] __attribute__((aligned(4)));
+static uint8_t temp_buffer[qrcodegen_BUFFER_LEN_MAX] __attribute__((aligned(4)));
+static uint8_t stream[QR_BITMAP_STREAM_LEN_MAX(qrcodegen_VERSION_MAX)];
+static char base64[QR_BITMAP_BASE64_LEN(sizeof(stream)) + 1];
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-v max version] [-c chunk length] <text>\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    int version_max = VERSION_MAX_DEFAULT;
+    int chunk_length = CHUNK_LENGTH_DEFAULT;
+    char text[TEXT_LENGTH_MAX + 2];
+    int option;
+
+    while ((option = getopt(argc, argv, "v:c:")) != -1)
+    {
+        if (option == 'v')
+        {
+            version_max = atoi(optarg);
+        }
+        else if (option == 'c')
+        {
+            chunk_length = atoi(optarg);
+        }
+        else
+        {
+            usage(argv[0]);
+
+            return 2;
+        }
+    }
+
+    if (optind + 1 != argc || version_max < qrcodegen_VERSION_MIN || version_max > qrcodegen_VERSION_MAX || chunk_length < 4 || chunk_length % 4 != 0)
+    {
+        usage(argv[0]);
+
+        return 2;
+    }
+
+    const char *value = argv[optind];
+    size_t length = strlen(value);
+
+    // Strip the quotes of the JSON string made by the String builder
+    if (length >= 2 && value[0] == '"' && value[length - 1] == '"')
+    {
+        value++;
+        length -= 2;
+    }
+
+    if (length + 1 > TEXT_LENGTH_MAX)
+    {
+        fprintf(stderr, "Text is longer than %d characters\n", TEXT_LENGTH_MAX - 1);
+
+        return 1;
+    }
+
+    memcpy(text, value, length);
+    strcpy(&text[length], ";");
+
+    if (!qrcodegen_encodeTextOptimal(text, temp_buffer, qrcode, qrcodegen_Ecc_LOW, qrcodegen_VERSION_MIN, version_max, qrcodegen_Mask_AUTO, true))
+    {
+        fprintf(stderr, "Text does not fit QR code version %d\n", version_max);
+
+        return 1;
+    }
+
+    size_t stream_length = qr_bitmap_encode(qrcode, stream, sizeof(stream));
+    size_t total = qr_bitmap_base64_encode(stream, stream_length, base64, sizeof(base64));
+
+    if (stream_length == 0 || total == 0)
+    {
+        fprintf(stderr, "Bitmap stream does not fit\n");
+
+        return 1;
+    }
+
+    for (size_t offset = 0; offset < total; offset += chunk_length)
+    {
+        printf("%zu,%zu:%.*s\n", total, offset, chunk_length, &base64[offset]);
+    }
+
+    fprintf(stderr, "version %d, %zu modules packed into %zu bytes, stream %zu bytes, %zu parts\n",
+        (qrcodegen_getSize(qrcode) - 17) / 4, (size_t) qrcodegen_getSize(qrcode) * qrcodegen_getSize(qrcode),
+        (size_t) QR_BITMAP_PACKED_LEN((qrcodegen_getSize(qrcode) - 17) / 4), stream_length, (total + chunk_length - 1) / chunk_length);
+
+    return 0;
+}
@@ -0,0 +1,480 @@
+/*
+Host benchmark and conformance check of the QR code encoder
+
+qrbench --bench [max version]   times qrcodegen_encodeText per version, ECC level and mask mode
+qrbench --check <golden file>   compares the symbols of all test cases with the golden symbols
+qrbench --golden                prints the golden symbols made by the current encoder
+
+The test cases are Wi-Fi payloads that just fill every version from 2 to 40 at the low ECC level, followed by numeric,
+alphanumeric and other texts. Symbols are compared by the size and 64-bit FNV-1a hash of their modules, so the check
+does not depend on the buffer layout of the encoder. The check also sends every symbol through the bitmap stream of the
+gateway encoder and back, and makes sure that qrcodegen_encodeTextOptimal never needs a larger symbol than
+qrcodegen_encodeText.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <qrcodegen.h>
+#include <qr_bitmap.h>
+
+#define WIFI_VERSION_MIN 2
+#define WIFI_VERSION_MAX 40
+#define TEXT_MAX_LENGTH 7100
+#define BENCH_MIN_TIME_NS 20000000
+#define GOLDEN_MAX_RECORDS 1024
+
+// Characters that fit the byte mode at the low ECC level for every version, the "WIFI:S:;T:WPA;P:;;" frame does not fit version 1
+static const int byte_capacity_low[41] = {
+    0, 17, 32, 53, 78, 106, 134, 154, 192, 230, 271, 321, 367, 425, 458, 520, 586, 644, 718, 792, 858,
+    929, 1003, 1091, 1171, 1273, 1367, 1465, 1528, 1628, 1732, 1840, 1952, 2068, 2188, 2303, 2431, 2563, 2699, 2809, 2953
+};
+
+static const char *ecc_names = "LMQH";
+
+// One line of the golden file, mask is qrcodegen_Mask_AUTO or a fixed mask and size is 0 if the text does not fit
+typedef struct
+{
+    int index;
+    int ecc;
+    int mask;
+    int size;
+    uint64_t hash;
+} golden_t;
+
+static uint8_t qrcode[qrcodegen_BUFFER_LEN_MAX] __attribute__((aligned(4)));
+static uint8_t temp_buffer[qrcodegen_BUFFER_LEN_MAX] __attribute__((aligned(4)));
+static char text[TEXT_MAX_LENGTH + 1];
+static uint8_t bitmap_symbol[qrcodegen_BUFFER_LEN_MAX] __attribute__((aligned(4)));
+static uint8_t bitmap_stream[QR_BITMAP_STREAM_LEN_MAX(qrcodegen_VERSION_MAX)];
+static char bitmap_text[QR_BITMAP_BASE64_LEN(sizeof(bitmap_stream)) + 1];
+
+static uint32_t random_state;
+
+/*
+Simple linear congruential generator, it keeps the test cases the same on every host
+*/
+static uint32_t random_next(void)
+{
+    random_state = random_state * 1664525 + 1013904223;
+
+    return random_state >> 8;
+}
+
+static void random_string(char *buffer, int length, const char *charset)
+{
+    size_t count = strlen(charset);
+
+    for (int i = 0; i < length; i++)
+    {
+        buffer[i] = charset[random_next() % count];
+    }
+
+    buffer[length] = '\0';
+}
+
+/*
+This function will make the Wi-Fi payload that just fills the given version at the low ECC level
+*/
+static void make_wifi_payload(int version)
+{
+    char ssid[16];
+    char password[3000];
+    int ssid_length = 1 + (version * 7) % 13;
+    int password_length = byte_capacity_low[version] - 18 - ssid_length;
+
+    random_state = version;
+    random_string(ssid, ssid_length, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_ ");
+    random_string(password, password_length, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789!#$%&()*+,-./<=>?@[]^_{|}~");
+
+    snprintf(text, sizeof(text), "WIFI:S:%s;T:WPA;P:%s;;", ssid, password);
+}
+
+/*
+This function will make the text of the test case with the given index and return false past the last test case
+*/
+static bool make_case(int index)
+{
+    static const int numeric_lengths[] = { 1, 41, 652, 7089 };
+    static const int alphanumeric_lengths[] = { 25, 224, 1249, 4296 };
+    static const char *other_texts[] = { "", "Hello, world!", "WIFI:S:test;T:test;P:test;;", "Wi-Fi \xc5\x99\xc3\xad\xc5\xbe\xc3\xad\xc4\x8d" };
+    int count;
+
+    if (index < 0)
+    {
+        return false;
+    }
+
+    count = WIFI_VERSION_MAX - WIFI_VERSION_MIN + 1;
+
+    if (index < count)
+    {
+        make_wifi_payload(WIFI_VERSION_MIN + index);
+
+        return true;
+    }
+
+    index -= count;
+    count = sizeof(numeric_lengths) / sizeof(numeric_lengths[0]);
+
+    if (index < count)
+    {
+        random_state = 100 + index;
+        random_string(text, numeric_lengths[index], "0123456789");
+
+        return true;
+    }
+
+    index -= count;
+    count = sizeof(alphanumeric_lengths) / sizeof(alphanumeric_lengths[0]);
+
+    if (index < count)
+    {
+        random_state = 200 + index;
+        random_string(text, alphanumeric_lengths[index], "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:");
+
+        return true;
+    }
+
+    index -= count;
+    count = sizeof(other_texts) / sizeof(other_texts[0]);
+
+    if (index < count)
+    {
+        strcpy(text, other_texts[index]);
+
+        return true;
+    }
+
+    return false;
+}
+
+/*
+The fixed mask patterns are checked only for every fourth test case to keep the golden file small
+*/
+static bool case_has_fixed_masks(int index)
+{
+    return index % 4 == 0;
+}
+
+/*
+64-bit FNV-1a hash of the modules of the symbol, row by row
+*/
+static uint64_t symbol_hash(const uint8_t symbol[])
+{
+    uint64_t hash = UINT64_C(14695981039346656037);
+    int size = qrcodegen_getSize(symbol);
+
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x += 8)
+        {
+            uint8_t byte = 0;
+
+            for (int i = 0; i < 8; i++)
+            {
+                byte = (byte << 1) | qrcodegen_getModule(symbol, x + i, y);
+            }
+
+            hash ^= byte;
+            hash *= UINT64_C(1099511628211);
+        }
+    }
+
+    return hash;
+}
+
+static bool encode(int ecc, int mask)
+{
+    return qrcodegen_encodeText(text, temp_buffer, qrcode, (enum qrcodegen_Ecc) ecc, qrcodegen_VERSION_MIN, qrcodegen_VERSION_MAX, (enum qrcodegen_Mask) mask, false);
+}
+
+static bool encode_optimal(int ecc, int mask)
+{
+    return qrcodegen_encodeTextOptimal(text, temp_buffer, qrcode, (enum qrcodegen_Ecc) ecc, qrcodegen_VERSION_MIN, qrcodegen_VERSION_MAX, (enum qrcodegen_Mask) mask, false);
+}
+
+/*
+This function will tell if the symbol of the last encoding comes back the same from the bitmap stream and its base64 text
+*/
+static bool bitmap_round_trip(void)
+{
+    size_t stream_length = qr_bitmap_encode(qrcode, bitmap_stream, sizeof(bitmap_stream));
+    size_t text_length = qr_bitmap_base64_encode(bitmap_stream, stream_length, bitmap_text, sizeof(bitmap_text));
+    size_t decoded_length;
+
+    memset(bitmap_stream, 0, sizeof(bitmap_stream));
+
+    return stream_length != 0 && text_length != 0 &&
+        qr_bitmap_base64_decode(bitmap_text, text_length, bitmap_stream, &decoded_length) && decoded_length == stream_length &&
+        qr_bitmap_decode(bitmap_stream, decoded_length, bitmap_symbol, qrcodegen_VERSION_MAX) &&
+        qrcodegen_getSize(bitmap_symbol) == qrcodegen_getSize(qrcode) && symbol_hash(bitmap_symbol) == symbol_hash(qrcode);
+}
+
+/*
+This function will tell if the symbol of the last encoding is equal to the golden symbol, ok is the result of the encoding
+*/
+static bool record_matches(const golden_t *record, bool ok)
+{
+    if (!ok)
+    {
+        return record->size == 0;
+    }
+
+    return record->size == qrcodegen_getSize(qrcode) && record->hash == symbol_hash(qrcode);
+}
+
+/*
+This function will print one golden line: case index, ECC level, mask, symbol size and hash, the size is 0 if the text does not fit
+*/
+static void print_golden_line(int index, int ecc, int mask)
+{
+    char mask_name[8];
+
+    if (mask == qrcodegen_Mask_AUTO)
+    {
+        strcpy(mask_name, "auto");
+    }
+    else
+    {
+        snprintf(mask_name, sizeof(mask_name), "%d", mask);
+    }
+
+    if (encode(ecc, mask))
+    {
+        printf("%d %c %s %d %016llx\n", index, ecc_names[ecc], mask_name, qrcodegen_getSize(qrcode), (unsigned long long) symbol_hash(qrcode));
+    }
+    else
+    {
+        printf("%d %c %s 0 0\n", index, ecc_names[ecc], mask_name);
+    }
+}
+
+static int golden(void)
+{
+    printf("# Golden QR code symbols of qrbench, regenerate only when the encoder output is meant to change\n");
+    printf("# case ecc mask size hash\n");
+
+    for (int index = 0; make_case(index); index++)
+    {
+        for (int ecc = 0; ecc < 4; ecc++)
+        {
+            print_golden_line(index, ecc, qrcodegen_Mask_AUTO);
+
+            for (int mask = 0; mask < 8 && case_has_fixed_masks(index); mask++)
+            {
+                print_golden_line(index, ecc, mask);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+This function will compare the golden file with the symbols of the current encoder
+
+The qrcodegen_Mask_FAST symbols have no golden lines of their own, they must be equal to the golden symbol of one of the fixed masks
+*/
+static int check(const char *path)
+{
+    static golden_t records[GOLDEN_MAX_RECORDS];
+    int record_count = 0;
+    int checked = 0;
+    int failed = 0;
+    FILE *file = fopen(path, "r");
+    char line[128];
+
+    if (file == NULL)
+    {
+        perror(path);
+
+        return 2;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        golden_t *record = &records[record_count];
+        char ecc_name;
+        char mask_name[8];
+        unsigned long long hash;
+
+        if (line[0] == '#')
+        {
+            continue;
+        }
+
+        if (record_count == GOLDEN_MAX_RECORDS ||
+            sscanf(line, "%d %c %7s %d %llx", &record->index, &ecc_name, mask_name, &record->size, &hash) != 5 ||
+            strchr(ecc_names, ecc_name) == NULL)
+        {
+            fprintf(stderr, "%s: malformed or too many lines\n", path);
+            fclose(file);
+
+            return 2;
+        }
+
+        record->ecc = strchr(ecc_names, ecc_name) - ecc_names;
+        record->mask = strcmp(mask_name, "auto") == 0 ? qrcodegen_Mask_AUTO : atoi(mask_name);
+        record->hash = hash;
+        record_count++;
+    }
+
+    fclose(file);
+
+    for (int i = 0; i < record_count; i++)
+    {
+        golden_t *record = &records[i];
+
+        checked++;
+
+        if (!make_case(record->index) || !record_matches(record, encode(record->ecc, record->mask)))
+        {
+            failed++;
+            printf("FAIL case %d ecc %c mask %d\n", record->index, ecc_names[record->ecc], record->mask);
+        }
+        else if (record->size != 0 && !bitmap_round_trip())
+        {
+            failed++;
+            printf("FAIL case %d ecc %c mask %d: bitmap stream\n", record->index, ecc_names[record->ecc], record->mask);
+        }
+    }
+
+    for (int index = 0; make_case(index); index++)
+    {
+        for (int ecc = 0; ecc < 4 && case_has_fixed_masks(index); ecc++)
+        {
+            bool ok = encode(ecc, qrcodegen_Mask_FAST);
+            bool found = false;
+
+            for (int i = 0; i < record_count && !found; i++)
+            {
+                golden_t *record = &records[i];
+
+                found = record->index == index && record->ecc == ecc && record->mask >= 0 && record_matches(record, ok);
+            }
+
+            checked++;
+
+            if (!found)
+            {
+                failed++;
+                printf("FAIL case %d ecc %c mask fast: no fixed mask symbol matches\n", index, ecc_names[ecc]);
+            }
+        }
+    }
+
+    for (int index = 0; make_case(index); index++)
+    {
+        for (int ecc = 0; ecc < 4; ecc++)
+        {
+            int size = encode(ecc, qrcodegen_Mask_AUTO) ? qrcodegen_getSize(qrcode) : 0;
+            bool ok = encode_optimal(ecc, qrcodegen_Mask_AUTO);
+
+            checked++;
+
+            if (size != 0 && (!ok || qrcodegen_getSize(qrcode) > size || !bitmap_round_trip()))
+            {
+                failed++;
+                printf("FAIL case %d ecc %c optimal: size %d instead of at most %d\n", index, ecc_names[ecc], ok ? qrcodegen_getSize(qrcode) : 0, size);
+            }
+        }
+    }
+
+    printf("%d symbols checked, %d failed\n", checked, failed);
+
+    return failed == 0 && checked > 0 ? 0 : 1;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+This function will return the mean time of one encoding in microseconds, it repeats the encoding for at least BENCH_MIN_TIME_NS
+*/
+static double bench_encode(int ecc, int mask)
+{
+    long count = 0;
+    double start = now_ns();
+    double elapsed;
+
+    do
+    {
+        encode(ecc, mask);
+        count++;
+        elapsed = now_ns() - start;
+    }
+    while (elapsed < BENCH_MIN_TIME_NS);
+
+    return elapsed / count / 1000;
+}
+
+static int bench(int version_max)
+{
+    // Numbers from builds with and without NDEBUG are not comparable, the assertions of the encoder cost up to half of the time
+#ifdef NDEBUG
+    printf("# qrcodegen_encodeText, assertions off (NDEBUG)\n");
+#else
+    printf("# qrcodegen_encodeText, assertions on\n");
+#endif
+    printf("payload ecc version    auto_us    fast_us   mask0_us\n");
+
+    for (int version = WIFI_VERSION_MIN; version <= version_max; version++)
+    {
+        make_wifi_payload(version);
+
+        for (int ecc = 0; ecc < 4; ecc++)
+        {
+            if (!encode(ecc, qrcodegen_Mask_AUTO))
+            {
+                continue;
+            }
+
+            int got = (qrcodegen_getSize(qrcode) - 17) / 4;
+
+            printf("v%-6d %c   %7d %10.1f %10.1f %10.1f\n", version, ecc_names[ecc], got,
+                bench_encode(ecc, qrcodegen_Mask_AUTO), bench_encode(ecc, qrcodegen_Mask_FAST), bench_encode(ecc, qrcodegen_Mask_0));
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0)
+    {
+        int version_max = argc >= 3 ? atoi(argv[2]) : 10;
+
+        if (version_max < WIFI_VERSION_MIN || version_max > WIFI_VERSION_MAX)
+        {
+            version_max = WIFI_VERSION_MAX;
+        }
+
+        return bench(version_max);
+    }
+
+    if (argc == 3 && strcmp(argv[1], "--check") == 0)
+    {
+        return check(argv[2]);
+    }
+
+    if (argc == 2 && strcmp(argv[1], "--golden") == 0)
+    {
+        return golden();
+    }
+
+    fprintf(stderr, "Usage: %s --bench [max version] | --check <golden file> | --golden\n", argv[0]);
+
+    return 2;
+}
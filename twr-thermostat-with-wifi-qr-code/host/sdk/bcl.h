@@ -0,0 +1,14 @@
+/*
+Host version of the names of the older SDK that the firmware still uses
+*/
+
+#ifndef _BCL_H
+#define _BCL_H
+
+#include <twr.h>
+
+typedef twr_tick_t bc_tick_t;
+
+#define bc_scheduler_get_spin_tick twr_scheduler_get_spin_tick
+
+#endif // _BCL_H
@@ -0,0 +1,274 @@
+/*
+Host version of the parts of the TOWER SDK that the firmware uses, implemented by lcdsim.c
+
+Types and functions keep the names and signatures of the SDK, so the firmware sources build unchanged. The display
+driver keeps the framebuffer layout of the ls013b7dh03 driver, because the firmware writes into it directly. Fonts are
+stand-ins: the 5x7 host font scaled to about the height of the Ubuntu font they replace.
+*/
+
+#ifndef _TWR_H
+#define _TWR_H
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Scheduler
+
+typedef uint64_t twr_tick_t;
+typedef size_t twr_scheduler_task_id_t;
+
+#define TWR_TICK_INFINITY ((twr_tick_t) -1)
+
+twr_tick_t twr_tick_get(void);
+twr_tick_t twr_scheduler_get_spin_tick(void);
+twr_scheduler_task_id_t twr_scheduler_register(void (*task)(void *), void *param, twr_tick_t tick);
+void twr_scheduler_unregister(twr_scheduler_task_id_t task_id);
+twr_scheduler_task_id_t twr_scheduler_get_current_task_id(void);
+void twr_scheduler_plan_now(twr_scheduler_task_id_t task_id);
+void twr_scheduler_plan_absolute(twr_scheduler_task_id_t task_id, twr_tick_t tick);
+void twr_scheduler_plan_relative(twr_scheduler_task_id_t task_id, twr_tick_t tick);
+void twr_scheduler_plan_current_now(void);
+void twr_scheduler_plan_current_absolute(twr_tick_t tick);
+void twr_scheduler_plan_current_relative(twr_tick_t tick);
+
+// System, EEPROM and log
+
+void twr_system_pll_enable(void);
+void twr_system_pll_disable(void);
+
+bool twr_eeprom_write(uint32_t address, const void *buffer, size_t length);
+bool twr_eeprom_read(uint32_t address, void *buffer, size_t length);
+size_t twr_eeprom_get_size(void);
+
+typedef enum
+{
+    TWR_LOG_LEVEL_DUMP = -1,
+    TWR_LOG_LEVEL_OFF = 0,
+    TWR_LOG_LEVEL_ERROR = 1,
+    TWR_LOG_LEVEL_WARNING = 2,
+    TWR_LOG_LEVEL_INFO = 3,
+    TWR_LOG_LEVEL_DEBUG = 4
+} twr_log_level_t;
+
+typedef enum
+{
+    TWR_LOG_TIMESTAMP_OFF = -1,
+    TWR_LOG_TIMESTAMP_ABS = 0,
+    TWR_LOG_TIMESTAMP_REL = 1
+} twr_log_timestamp_t;
+
+void twr_log_init(twr_log_level_t level, twr_log_timestamp_t timestamp);
+void twr_log_debug(const char *format, ...);
+void twr_log_info(const char *format, ...);
+void twr_log_warning(const char *format, ...);
+void twr_log_error(const char *format, ...);
+
+// Radio
+
+typedef enum
+{
+    TWR_RADIO_MODE_UNKNOWN = 0,
+    TWR_RADIO_MODE_GATEWAY = 1,
+    TWR_RADIO_MODE_NODE_LISTENING = 2,
+    TWR_RADIO_MODE_NODE_SLEEPING = 3
+} twr_radio_mode_t;
+
+typedef enum
+{
+    TWR_RADIO_SUB_PT_BOOL = 0,
+    TWR_RADIO_SUB_PT_INT = 1,
+    TWR_RADIO_SUB_PT_FLOAT = 2,
+    TWR_RADIO_SUB_PT_STRING = 3,
+    TWR_RADIO_SUB_PT_NULL = 4
+} twr_radio_sub_pt_t;
+
+typedef struct
+{
+    const char *topic;
+    twr_radio_sub_pt_t type;
+    void (*callback)(uint64_t *id, const char *topic, void *value, void *param);
+    void *param;
+} twr_radio_sub_t;
+
+enum
+{
+    TWR_RADIO_PUB_CHANNEL_R1_I2C0_ADDRESS_DEFAULT = 0,
+    TWR_RADIO_PUB_CHANNEL_R1_I2C0_ADDRESS_ALTERNATE = 1,
+    TWR_RADIO_PUB_CHANNEL_R1_I2C1_ADDRESS_DEFAULT = 2,
+    TWR_RADIO_PUB_CHANNEL_R1_I2C1_ADDRESS_ALTERNATE = 3,
+    TWR_RADIO_PUB_CHANNEL_SET_POINT = 0xff
+};
+
+void twr_radio_init(twr_radio_mode_t mode);
+void twr_radio_set_subs(twr_radio_sub_t *subs, int length);
+void twr_radio_set_rx_timeout_for_sleeping_node(twr_tick_t timeout);
+void twr_radio_pairing_request(const char *firmware, const char *version);
+bool twr_radio_pub_temperature(uint8_t channel, float *celsius);
+bool twr_radio_pub_battery(float *voltage);
+bool twr_radio_pub_push_button(uint16_t *event_count);
+bool twr_radio_pub_int(const char *subtopic, int *value);
+bool twr_radio_pub_float(const char *subtopic, float *value);
+bool twr_radio_pub_bool(const char *subtopic, bool *value);
+bool twr_radio_pub_string(const char *subtopic, const char *value);
+bool twr_radio_pub_buffer(void *buffer, size_t length);
+
+// Temperature tag
+
+typedef enum
+{
+    TWR_I2C_I2C0 = 0,
+    TWR_I2C_I2C1 = 1
+} twr_i2c_channel_t;
+
+#define TWR_TAG_TEMPERATURE_I2C_ADDRESS_DEFAULT 0x48
+#define TWR_TAG_TEMPERATURE_I2C_ADDRESS_ALTERNATE 0x49
+
+typedef enum
+{
+    TWR_TMP112_EVENT_ERROR = 0,
+    TWR_TMP112_EVENT_UPDATE = 1
+} twr_tmp112_event_t;
+
+typedef struct twr_tmp112_t twr_tmp112_t;
+
+struct twr_tmp112_t
+{
+    void (*_event_handler)(twr_tmp112_t *, twr_tmp112_event_t, void *);
+    void *_event_param;
+    twr_scheduler_task_id_t _task_id;
+    twr_tick_t _update_interval;
+};
+
+void twr_tmp112_init(twr_tmp112_t *self, twr_i2c_channel_t i2c_channel, uint8_t i2c_address);
+void twr_tmp112_set_event_handler(twr_tmp112_t *self, void (*event_handler)(twr_tmp112_t *, twr_tmp112_event_t, void *), void *event_param);
+void twr_tmp112_set_update_interval(twr_tmp112_t *self, twr_tick_t interval);
+bool twr_tmp112_get_temperature_celsius(twr_tmp112_t *self, float *celsius);
+
+// Battery module
+
+typedef enum
+{
+    TWR_MODULE_BATTERY_EVENT_LEVEL_LOW = 0,
+    TWR_MODULE_BATTERY_EVENT_LEVEL_CRITICAL = 1,
+    TWR_MODULE_BATTERY_EVENT_UPDATE = 2,
+    TWR_MODULE_BATTERY_EVENT_ERROR = 3
+} twr_module_battery_event_t;
+
+void twr_module_battery_init(void);
+void twr_module_battery_set_event_handler(void (*event_handler)(twr_module_battery_event_t, void *), void *event_param);
+void twr_module_battery_set_update_interval(twr_tick_t interval);
+bool twr_module_battery_get_voltage(float *voltage);
+bool twr_module_battery_get_charge_level(int *percentage);
+
+// Graphics
+
+typedef struct
+{
+    uint16_t width;
+    uint16_t height;
+} twr_gfx_caps_t;
+
+typedef struct
+{
+    bool (*is_ready)(void *self);
+    void (*clear)(void *self);
+    void (*draw_pixel)(void *self, int left, int top, uint32_t color);
+    uint32_t (*get_pixel)(void *self, int left, int top);
+    bool (*update)(void *self);
+    twr_gfx_caps_t (*get_caps)(void *self);
+} twr_gfx_driver_t;
+
+// Stand-in of an SDK font, the host font drawn in blocks of scale pixels in a box of the font height
+typedef struct
+{
+    uint8_t height;
+    uint8_t scale;
+} twr_font_t;
+
+extern const twr_font_t twr_font_ubuntu_13;
+extern const twr_font_t twr_font_ubuntu_15;
+extern const twr_font_t twr_font_ubuntu_24;
+extern const twr_font_t twr_font_ubuntu_33;
+
+typedef struct
+{
+    void *_display;
+    const twr_gfx_driver_t *_driver;
+    const twr_font_t *_font;
+    twr_gfx_caps_t _caps;
+} twr_gfx_t;
+
+bool twr_gfx_display_is_ready(twr_gfx_t *self);
+twr_gfx_caps_t twr_gfx_get_caps(twr_gfx_t *self);
+void twr_gfx_clear(twr_gfx_t *self);
+void twr_gfx_set_font(twr_gfx_t *self, const twr_font_t *font);
+void twr_gfx_draw_pixel(twr_gfx_t *self, int left, int top, uint32_t color);
+int twr_gfx_draw_char(twr_gfx_t *self, int left, int top, uint8_t ch, uint32_t color);
+int twr_gfx_calc_char_width(twr_gfx_t *self, uint8_t ch);
+int twr_gfx_draw_string(twr_gfx_t *self, int left, int top, char *str, uint32_t color);
+int twr_gfx_calc_string_width(twr_gfx_t *self, char *str);
+void twr_gfx_draw_fill_rectangle(twr_gfx_t *self, int x0, int y0, int x1, int y1, uint32_t color);
+bool twr_gfx_update(twr_gfx_t *self);
+
+// Memory LCD driver and LCD module
+
+#define TWR_LS013B7DH03_WIDTH 128
+#define TWR_LS013B7DH03_HEIGHT 128
+#define TWR_LS013B7DH03_FRAMEBUFFER_SIZE (TWR_LS013B7DH03_WIDTH * TWR_LS013B7DH03_HEIGHT / 8 + 2 + 2 * TWR_LS013B7DH03_HEIGHT)
+
+typedef struct
+{
+    bool (*_pin_cs_set)(bool state);
+    uint8_t _framebuffer[TWR_LS013B7DH03_FRAMEBUFFER_SIZE];
+    uint8_t _vcom;
+    twr_scheduler_task_id_t _task_id;
+} twr_ls013b7dh03_t;
+
+typedef enum
+{
+    TWR_MODULE_LCD_EVENT_LEFT_PRESS = 0,
+    TWR_MODULE_LCD_EVENT_LEFT_RELEASE = 1,
+    TWR_MODULE_LCD_EVENT_LEFT_CLICK = 2,
+    TWR_MODULE_LCD_EVENT_LEFT_HOLD = 3,
+    TWR_MODULE_LCD_EVENT_RIGHT_PRESS = 4,
+    TWR_MODULE_LCD_EVENT_RIGHT_RELEASE = 5,
+    TWR_MODULE_LCD_EVENT_RIGHT_CLICK = 6,
+    TWR_MODULE_LCD_EVENT_RIGHT_HOLD = 7,
+    TWR_MODULE_LCD_EVENT_BOTH_HOLD = 8
+} twr_module_lcd_event_t;
+
+void twr_module_lcd_init(void);
+twr_gfx_t *twr_module_lcd_get_gfx(void);
+bool twr_module_lcd_is_ready(void);
+void twr_module_lcd_set_event_handler(void (*event_handler)(twr_module_lcd_event_t, void *), void *event_param);
+void twr_module_lcd_set_button_hold_time(twr_tick_t hold_time);
+
+// SPI
+
+typedef enum
+{
+    TWR_SPI_SPEED_1_MHZ = 2
+} twr_spi_speed_t;
+
+typedef enum
+{
+    TWR_SPI_MODE_0 = 0
+} twr_spi_mode_t;
+
+typedef enum
+{
+    TWR_SPI_EVENT_DONE = 0
+} twr_spi_event_t;
+
+bool twr_spi_is_ready(void);
+void twr_spi_set_speed(twr_spi_speed_t speed);
+void twr_spi_set_mode(twr_spi_mode_t mode);
+bool twr_spi_async_transfer(const void *source, void *destination, size_t length, void (*event_handler)(twr_spi_event_t, void *), void *event_param);
+
+#endif // _TWR_H
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""
+Stack usage check of the QR code encoder
+
+stack_check.py <budget> <callgraph.ci> <function regex>...
+
+Reads the call graph that gcc -fcallgraph-info=su writes next to the object file and prints the deepest call path of
+every function that matches one of the regular expressions. Functions outside the translation unit (assert, memcpy, ...)
+count as 0 bytes. Fails when a path is longer than the budget in bytes, when a frame has a dynamic size or when the calls
+are recursive, because the stack usage then has no bound.
+"""
+
+import re
+import sys
+
+NODE = re.compile(r'node: \{ title: "([^"]+)" label: "[^\\]*\\n[^\\]*(?:\\n(\d+) bytes \((\w+)\))?')
+EDGE = re.compile(r'edge: \{ sourcename: "([^"]+)" targetname: "([^"]+)"')
+
+
+def name_of(title):
+    return title.split(':')[-1]
+
+
+def main():
+    if len(sys.argv) < 4:
+        sys.stderr.write(__doc__.lstrip())
+        return 2
+
+    budget = int(sys.argv[1])
+    frames = {}
+    dynamic = set()
+    calls = {}
+
+    with open(sys.argv[2]) as graph:
+        for line in graph:
+            match = NODE.match(line)
+            if match:
+                title, size, kind = match.groups()
+                frames[title] = int(size) if size else 0
+                if kind is not None and kind != 'static':
+                    dynamic.add(title)
+                continue
+
+            match = EDGE.match(line)
+            if match:
+                calls.setdefault(match.group(1), set()).add(match.group(2))
+
+    deepest = {}
+
+    def walk(title, stack):
+        if title in stack:
+            raise ValueError('recursion: ' + ' -> '.join(name_of(t) for t in stack + [title]))
+        if title in deepest:
+            return deepest[title]
+
+        best = (0, [])
+        for callee in calls.get(title, ()):
+            usage, path = walk(callee, stack + [title])
+            if usage > best[0]:
+                best = (usage, path)
+
+        deepest[title] = (frames.get(title, 0) + best[0], [title] + best[1])
+        return deepest[title]
+
+    patterns = [re.compile(pattern) for pattern in sys.argv[3:]]
+    roots = sorted(title for title in frames if any(pattern.fullmatch(name_of(title)) for pattern in patterns))
+    failed = not roots
+
+    for root in roots:
+        try:
+            usage, path = walk(root, [])
+        except ValueError as error:
+            print('FAIL %s: %s' % (name_of(root), error))
+            failed = True
+            continue
+
+        unbounded = [name_of(title) for title in path if title in dynamic]
+        status = 'FAIL' if usage > budget or unbounded else 'ok'
+        failed = failed or status == 'FAIL'
+        print('%-4s %-34s %5d of %d bytes: %s' % (status, name_of(root), usage, budget,
+                                                  ' -> '.join('%s %d' % (name_of(title), frames[title]) for title in path if frames[title])))
+        if unbounded:
+            print('     dynamic frame in %s' % ', '.join(unbounded))
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
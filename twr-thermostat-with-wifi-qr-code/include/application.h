@@ -17,6 +17,8 @@ Autor: HARDWARIO s.r.o.
 
 void qrcode_handler(char *project_name);
 void twr_change_qr_value(uint64_t *id, const char *topic, void *value, void *param);
+void twr_change_qr_bitmap(uint64_t *id, const char *topic, void *value, void *param);
+void twr_change_set_point(uint64_t *id, const char *topic, void *value, void *param);
 void lcd_page_with_qr_code();
 
 typedef enum
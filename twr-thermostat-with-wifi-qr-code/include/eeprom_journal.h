@@ -0,0 +1,42 @@
+/*
+Journal of a float value in a ring of EEPROM records
+
+Setting the value only keeps it in RAM and plans the commit after the commit delay, every further change within the
+delay plans it again, so a burst of changes costs one EEPROM write. Each commit writes the next slot of the ring, so the
+writes are spread over all the slots. A record is the sequence number, the CRC16 of the sequence number and the value,
+and the value. The newest valid record is found by one scan of the ring at boot, a record torn by a reset fails its CRC
+and the one before it is used.
+*/
+
+#ifndef _EEPROM_JOURNAL_H
+#define _EEPROM_JOURNAL_H
+
+#include <twr.h>
+
+// EEPROM space of a journal with the given number of slots
+#define EEPROM_JOURNAL_SIZE(slots) ((slots) * 8)
+
+typedef struct
+{
+    uint32_t address;
+    int slots;
+    twr_tick_t commit_delay;
+    twr_scheduler_task_id_t task_id;
+
+    // Value that was set last and whether it is not written yet
+    float value;
+    bool pending;
+
+    // Newest record in the EEPROM, the slot is -1 when there is none
+    int slot;
+    uint16_t sequence;
+    float committed;
+
+    uint32_t commits;
+} eeprom_journal_t;
+
+bool eeprom_journal_init(eeprom_journal_t *self, uint32_t address, int slots, twr_tick_t commit_delay, float *value);
+void eeprom_journal_set(eeprom_journal_t *self, float value);
+bool eeprom_journal_commit(eeprom_journal_t *self);
+
+#endif // _EEPROM_JOURNAL_H
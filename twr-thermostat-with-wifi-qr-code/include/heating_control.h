@@ -0,0 +1,34 @@
+/*
+Hysteresis control of the heating
+
+The heating is switched on when the temperature falls below the set point by half of the hysteresis and off when it rises
+above the set point by half of the hysteresis, in between it stays as it is. A state lasts at least its minimum time, so a
+reading that would switch the heating earlier is ignored and the next reading after the minimum time decides. Without a
+valid temperature the heating is switched off right away.
+*/
+
+#ifndef _HEATING_CONTROL_H
+#define _HEATING_CONTROL_H
+
+#include <twr.h>
+
+typedef struct
+{
+    float hysteresis;
+    twr_tick_t min_on_time;
+    twr_tick_t min_off_time;
+
+    // State of the heating, it is not known until the first update
+    bool heating;
+    bool known;
+    twr_tick_t changed_tick;
+
+    uint32_t switches;
+    uint32_t held_back;
+} heating_control_t;
+
+void heating_control_init(heating_control_t *self, float hysteresis, twr_tick_t min_on_time, twr_tick_t min_off_time);
+bool heating_control_update(heating_control_t *self, float temperature, float set_point);
+bool heating_control_get_state(const heating_control_t *self);
+
+#endif // _HEATING_CONTROL_H
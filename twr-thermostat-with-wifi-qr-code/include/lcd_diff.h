@@ -0,0 +1,34 @@
+/*
+Line-level update of the memory LCD
+
+The Sharp memory LCD takes a write of any set of lines, every line carries its own address. A shadow copy of the lines on the
+display is compared with the framebuffer on every update, and only the lines that differ are sent. Neighbouring changed
+lines are sent together by one SPI transfer straight from the framebuffer of the ls013b7dh03 driver.
+
+The shadow can be lent out as a page snapshot, so that the RAM of the display is not kept twice. Every update goes through the
+driver while it is lent, the first update after it is returned fills it again.
+*/
+
+#ifndef _LCD_DIFF_H
+#define _LCD_DIFF_H
+
+#include <twr.h>
+
+typedef struct
+{
+    // Number of updates and of the lines they have sent
+    uint32_t updates;
+    uint32_t lines;
+
+    // Lines and SPI transfers of the last update
+    uint16_t last_lines;
+    uint16_t last_transfers;
+} lcd_diff_stats_t;
+
+bool lcd_diff_update(twr_gfx_t *gfx);
+void lcd_diff_invalidate(void);
+uint8_t *lcd_diff_lend_shadow(void);
+void lcd_diff_return_shadow(void);
+const lcd_diff_stats_t *lcd_diff_get_stats(void);
+
+#endif // _LCD_DIFF_H
@@ -0,0 +1,44 @@
+/*
+Glyph sprites of the few characters of a large font, drawn straight into the LCD framebuffer
+
+The gfx string path looks every character up in the font and draws it pixel by pixel through the display driver. The
+characters that a reading is made of are rasterised once at boot into row-major 1bpp sprites instead, every row most
+significant bit first with black as 1, trimmed to the rows with black pixels. Drawing a string then writes each sprite
+row into the framebuffer with a few shifts and masks. It relies on the display not being rotated, like the QR code page.
+*/
+
+#ifndef _LCD_GLYPH_H
+#define _LCD_GLYPH_H
+
+#include <twr.h>
+
+#define LCD_GLYPH_COUNT_MAX 16
+
+// Widest glyph that a sprite can hold, wider glyphs are left to the gfx string path
+#define LCD_GLYPH_WIDTH_MAX 24
+
+// Size of the text of lcd_glyph_format_tenths for any value
+#define LCD_GLYPH_TENTHS_SIZE 14
+
+typedef struct
+{
+    char code;
+    uint8_t width;
+    uint8_t top;
+    uint8_t rows;
+    uint16_t offset;
+} lcd_glyph_t;
+
+typedef struct
+{
+    lcd_glyph_t glyphs[LCD_GLYPH_COUNT_MAX];
+    size_t count;
+    const uint8_t *data;
+} lcd_glyph_font_t;
+
+size_t lcd_glyph_font_init(lcd_glyph_font_t *self, twr_gfx_t *gfx, const twr_font_t *font, const char *charset, uint8_t *data, size_t size);
+int lcd_glyph_calc_string_width(const lcd_glyph_font_t *self, const char *text);
+int lcd_glyph_draw_string(const lcd_glyph_font_t *self, twr_gfx_t *gfx, int left, int top, const char *text);
+void lcd_glyph_format_tenths(char *text, int32_t tenths);
+
+#endif // _LCD_GLYPH_H
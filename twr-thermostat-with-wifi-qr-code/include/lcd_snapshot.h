@@ -0,0 +1,41 @@
+/*
+Snapshots of the rendered LCD framebuffer of a page
+
+A snapshot keeps the 128 lines of a page as they were drawn, in RAM or in the EEPROM for a page that rarely changes, together
+with a tag that says what the page showed. Restoring it fills the framebuffer again without drawing the page, then only the
+parts that changed since need to be drawn. The EEPROM snapshot survives a reset.
+
+A snapshot can also borrow the shadow of lcd_diff instead of its own RAM. It takes the shadow when it is saved and gives it back
+when it is restored, so it is restored only once.
+*/
+
+#ifndef _LCD_SNAPSHOT_H
+#define _LCD_SNAPSHOT_H
+
+#include <twr.h>
+
+#define LCD_SNAPSHOT_SIZE (128 * 16)
+
+// EEPROM space of a snapshot: tag, format and the lines
+#define LCD_SNAPSHOT_EEPROM_SIZE (2 * sizeof(uint32_t) + LCD_SNAPSHOT_SIZE)
+
+typedef struct
+{
+    // Buffer of LCD_SNAPSHOT_SIZE bytes, or NULL for the snapshot in the EEPROM
+    uint8_t *ram;
+    uint32_t eeprom_address;
+
+    // The buffer is the shadow of lcd_diff, borrowed while the snapshot is valid
+    bool shadow;
+
+    uint32_t tag;
+    bool valid;
+} lcd_snapshot_t;
+
+void lcd_snapshot_init_ram(lcd_snapshot_t *self, uint8_t *buffer);
+void lcd_snapshot_init_shadow(lcd_snapshot_t *self);
+void lcd_snapshot_init_eeprom(lcd_snapshot_t *self, uint32_t address);
+bool lcd_snapshot_save(lcd_snapshot_t *self, twr_gfx_t *gfx, uint32_t tag);
+bool lcd_snapshot_restore(lcd_snapshot_t *self, twr_gfx_t *gfx, uint32_t tag);
+
+#endif // _LCD_SNAPSHOT_H
@@ -0,0 +1,78 @@
+/*
+Text widgets of an LCD page that remember what is on the screen
+
+Every widget keeps the text it shows and the area it was drawn to. Setting the same text again does nothing, a changed
+text marks the widget dirty and plans a redraw of the page one frame later, so all the changes that arrive within one
+frame are drawn by a single update. The redraw clears and draws only the dirty widgets, and lcd_diff sends only the
+display lines they cover.
+
+A widget may be anchored to the right edge of another widget of the same page, listed before it, like a unit behind
+a value. It is moved and redrawn whenever the width of the anchor changes.
+
+A page may keep its rendered framebuffer in an lcd_snapshot while another page is shown. Showing it again then restores
+the snapshot and draws only the widgets whose text changed meanwhile, instead of clearing and drawing all of them.
+*/
+
+#ifndef _LCD_WIDGET_H
+#define _LCD_WIDGET_H
+
+#include <twr.h>
+#include <lcd_glyph.h>
+#include <lcd_snapshot.h>
+
+// Time in which the changes of the widgets are merged into one redraw
+#define LCD_WIDGET_FRAME_TIME 50
+
+#define LCD_WIDGET_TEXT_SIZE 16
+
+typedef struct lcd_widget_t lcd_widget_t;
+
+struct lcd_widget_t
+{
+    const twr_font_t *font;
+
+    // Sprites of the font for the texts made only of their characters, or NULL
+    const lcd_glyph_font_t *glyphs;
+
+    int left;
+    int top;
+    int height;
+
+    // Widget whose right edge plus the gap is the left edge of this one, or NULL
+    const lcd_widget_t *anchor;
+    int gap;
+
+    char text[LCD_WIDGET_TEXT_SIZE];
+    bool dirty;
+
+    // Area of the text on the screen, the width is 0 when nothing is drawn
+    int drawn_left;
+    int drawn_width;
+
+    // Area of the text after the redraw that is in progress
+    int next_left;
+    int next_width;
+};
+
+typedef struct
+{
+    twr_gfx_t *gfx;
+    lcd_widget_t *widgets;
+    size_t count;
+    twr_scheduler_task_id_t task_id;
+    lcd_snapshot_t *snapshot;
+    bool shown;
+    bool clear;
+    bool redraw_planned;
+
+    // The framebuffer has to be sent even when no widget is dirty, after a restore or a failed update
+    bool refresh;
+} lcd_widget_page_t;
+
+void lcd_widget_page_init(lcd_widget_page_t *self, twr_gfx_t *gfx, lcd_widget_t *widgets, size_t count);
+void lcd_widget_page_set_snapshot(lcd_widget_page_t *self, lcd_snapshot_t *snapshot);
+void lcd_widget_page_show(lcd_widget_page_t *self);
+void lcd_widget_page_hide(lcd_widget_page_t *self);
+void lcd_widget_set_text(lcd_widget_page_t *self, lcd_widget_t *widget, const char *text);
+
+#endif // _LCD_WIDGET_H
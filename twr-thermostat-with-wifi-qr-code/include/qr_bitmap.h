@@ -0,0 +1,35 @@
+/*
+Compressed bitmap of a QR code symbol, shared by the thermostat and the gateway encoder
+
+The stream starts with the format and the size of the symbol, followed by the modules packed row by row into bytes,
+most significant bit first, black module is 1. The packed modules are compressed with PackBits, or stored as they are when
+PackBits does not make them shorter, which is common because the mask makes the data modules look random.
+Over the radio the stream is sent as base64 text.
+*/
+
+#ifndef _QR_BITMAP_H
+#define _QR_BITMAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Formats of the stream, the first byte of every stream
+#define QR_BITMAP_FORMAT_STORED 1
+#define QR_BITMAP_FORMAT_PACKBITS 2
+
+// Length of the packed modules of a QR code symbol of the given version
+#define QR_BITMAP_PACKED_LEN(version) ((((version) * 4 + 17) * ((version) * 4 + 17) + 7) / 8)
+
+// Largest stream of a QR code symbol of the given version
+#define QR_BITMAP_STREAM_LEN_MAX(version) (2 + QR_BITMAP_PACKED_LEN(version))
+
+// Length of the base64 text of the given number of bytes, without the terminating NUL
+#define QR_BITMAP_BASE64_LEN(length) (((length) + 2) / 3 * 4)
+
+size_t qr_bitmap_encode(const uint8_t qrcode[], uint8_t *stream, size_t stream_size);
+bool qr_bitmap_decode(const uint8_t *stream, size_t length, uint8_t qrcode[], int version_max);
+size_t qr_bitmap_base64_encode(const uint8_t *data, size_t length, char *text, size_t text_size);
+bool qr_bitmap_base64_decode(const char *text, size_t length, uint8_t *data, size_t *data_length);
+
+#endif // _QR_BITMAP_H
@@ -48,6 +48,9 @@ enum qrcodegen_Mask {
 	// A special value to tell the QR Code encoder to
 	// automatically select an appropriate mask pattern
 	qrcodegen_Mask_AUTO = -1,
+	// Like qrcodegen_Mask_AUTO, but scores only the rows and the color balance
+	// of each candidate, which is faster and usually picks the same pattern
+	qrcodegen_Mask_FAST = -2,
 	// The eight actual mask patterns
 	qrcodegen_Mask_0 = 0,
 	qrcodegen_Mask_1,
@@ -107,12 +110,16 @@ struct qrcodegen_Segment {
 
 // Calculates the number of bytes needed to store any QR Code up to and including the given version number,
 // as a compile-time constant. For example, 'uint8_t buffer[qrcodegen_BUFFER_LEN_FOR_VERSION(25)];'
-// can store any single QR Code from version 1 to 25, inclusive.
+// can store any single QR Code from version 1 to 25, inclusive. The modules are stored
+// after a 4-byte header, with every row padded to a whole number of 32-bit words.
+// Every buffer passed to this library must be aligned to 4 bytes, for example with
+// '__attribute__((aligned(4)))' on its declaration; the words are accessed with memcpy,
+// so the buffer may still be declared as uint8_t.
 // Requires qrcodegen_VERSION_MIN <= n <= qrcodegen_VERSION_MAX.
-#define qrcodegen_BUFFER_LEN_FOR_VERSION(n)  ((((n) * 4 + 17) * ((n) * 4 + 17) + 7) / 8 + 1)
+#define qrcodegen_BUFFER_LEN_FOR_VERSION(n)  (4 + (((n) * 4 + 17 + 31) / 32) * 4 * ((n) * 4 + 17))
 
 // The worst-case number of bytes needed to store one QR Code, up to and including
-// version 40. This value equals 3918, which is just under 4 kilobytes.
+// version 40. This value equals 4252, which is just over 4 kilobytes.
 // Use this more convenient value to avoid calculating tighter memory bounds for buffers.
 #define qrcodegen_BUFFER_LEN_MAX  qrcodegen_BUFFER_LEN_FOR_VERSION(qrcodegen_VERSION_MAX)
 
@@ -128,7 +135,8 @@ struct qrcodegen_Segment {
  * - The variables ecl and mask must correspond to enum constant values.
  * - Requires 1 <= minVersion <= maxVersion <= 40.
  * - The arrays tempBuffer and qrcode must each have a length
- *   of at least qrcodegen_BUFFER_LEN_FOR_VERSION(maxVersion).
+ *   of at least qrcodegen_BUFFER_LEN_FOR_VERSION(maxVersion),
+ *   and must be aligned to 4 bytes.
  * - After the function returns, tempBuffer contains no useful data.
  * - If successful, the resulting QR Code may use numeric,
  *   alphanumeric, or byte mode to encode the text.
@@ -143,6 +151,36 @@ bool qrcodegen_encodeText(const char *text, uint8_t tempBuffer[], uint8_t qrcode
 	enum qrcodegen_Ecc ecl, int minVersion, int maxVersion, enum qrcodegen_Mask mask, bool boostEcl);
 
 
+/*
+ * Encodes the given text string like qrcodegen_encodeText(), but splits it into numeric,
+ * alphanumeric and byte segments wherever that saves bits, returning true if encoding succeeded.
+ * For example, the digits inside a Wi-Fi password take 10 bits per 3 characters instead of 24.
+ * The result never uses a higher version than qrcodegen_encodeText() would for the same text.
+ * - The input text must be encoded in UTF-8 and contain no NULs.
+ * - The variables ecl and mask must correspond to enum constant values.
+ * - Requires 1 <= minVersion <= maxVersion <= 40.
+ * - The arrays tempBuffer and qrcode must each have a length
+ *   of at least qrcodegen_BUFFER_LEN_FOR_VERSION(maxVersion),
+ *   and must be aligned to 4 bytes.
+ * - After the function returns, tempBuffer contains no useful data.
+ * - The segmentation takes time linear in the length of the text, and is
+ *   repeated at most three times while searching for the smallest version.
+ */
+bool qrcodegen_encodeTextOptimal(const char *text, uint8_t tempBuffer[], uint8_t qrcode[],
+	enum qrcodegen_Ecc ecl, int minVersion, int maxVersion, enum qrcodegen_Mask mask, bool boostEcl);
+
+
+/*
+ * Returns the smallest version in the given range that qrcodegen_encodeText() would use for the
+ * given text at the given ECC level, or 0 if the text does not fit in any version in the range.
+ * This only measures the text, so it is a cheap way to reject text before encoding it.
+ * - The input text must be encoded in UTF-8 and contain no NULs.
+ * - The variable ecl must correspond to an enum constant value.
+ * - Requires 1 <= minVersion <= maxVersion <= 40.
+ */
+int qrcodegen_getMinVersionForText(const char *text, enum qrcodegen_Ecc ecl, int minVersion, int maxVersion);
+
+
 /*
  * Encodes the given binary data to a QR Code symbol, returning true if encoding succeeded.
  * If the data is too long to fit in any version in the given range
@@ -152,7 +190,8 @@ bool qrcodegen_encodeText(const char *text, uint8_t tempBuffer[], uint8_t qrcode
  * - The variables ecl and mask must correspond to enum constant values.
  * - Requires 1 <= minVersion <= maxVersion <= 40.
  * - The arrays dataAndTemp and qrcode must each have a length
- *   of at least qrcodegen_BUFFER_LEN_FOR_VERSION(maxVersion).
+ *   of at least qrcodegen_BUFFER_LEN_FOR_VERSION(maxVersion),
+ *   and must be aligned to 4 bytes.
  * - After the function returns, the contents of dataAndTemp may have changed,
  *   and does not represent useful data anymore.
  * - If successful, the resulting QR Code will use byte mode to encode the data.
@@ -228,6 +267,7 @@ struct qrcodegen_Segment qrcodegen_makeEci(long assignVal, uint8_t buf[]);
  * To save memory, the segments' data buffers can alias/overlap tempBuffer, and will
  * result in them being clobbered, but the QR Code output will still be correct.
  * But the qrcode array must not overlap tempBuffer or any segment's data buffer.
+ * Both tempBuffer and qrcode must be aligned to 4 bytes.
  */
 bool qrcodegen_encodeSegments(const struct qrcodegen_Segment segs[], size_t len,
 	enum qrcodegen_Ecc ecl, uint8_t tempBuffer[], uint8_t qrcode[]);
@@ -243,6 +283,7 @@ bool qrcodegen_encodeSegments(const struct qrcodegen_Segment segs[], size_t len,
  * To save memory, the segments' data buffers can alias/overlap tempBuffer, and will
  * result in them being clobbered, but the QR Code output will still be correct.
  * But the qrcode array must not overlap tempBuffer or any segment's data buffer.
+ * Both tempBuffer and qrcode must be aligned to 4 bytes.
  */
 bool qrcodegen_encodeSegmentsAdvanced(const struct qrcodegen_Segment segs[], size_t len, enum qrcodegen_Ecc ecl,
 	int minVersion, int maxVersion, int mask, bool boostEcl, uint8_t tempBuffer[], uint8_t qrcode[]);
@@ -254,7 +295,7 @@ bool qrcodegen_encodeSegmentsAdvanced(const struct qrcodegen_Segment segs[], siz
  * Returns the side length of the given QR Code, assuming that encoding succeeded.
  * The result is in the range [21, 177]. Note that the length of the array buffer
  * is related to the side length - every 'uint8_t qrcode[]' must have length at least
- * qrcodegen_BUFFER_LEN_FOR_VERSION(version), which equals ceil(size^2 / 8 + 1).
+ * qrcodegen_BUFFER_LEN_FOR_VERSION(version), which equals 4 + ceil(size / 32) * 4 * size.
  */
 int qrcodegen_getSize(const uint8_t qrcode[]);
 
@@ -265,3 +306,20 @@ int qrcodegen_getSize(const uint8_t qrcode[]);
  * If the given coordinates are out of bounds, then false (white) is returned.
  */
 bool qrcodegen_getModule(const uint8_t qrcode[], int x, int y);
+
+
+/*
+ * Makes the given array an all-white QR Code symbol with the given side length, which must be
+ * 4 * version + 17 for a version in [1, 40]. The array must have a length of at least
+ * qrcodegen_BUFFER_LEN_FOR_VERSION(version) and be aligned to 4 bytes. Together with
+ * qrcodegen_setModule() this restores a symbol from modules stored elsewhere, such as a bitmap.
+ */
+void qrcodegen_initSymbol(uint8_t qrcode[], int size);
+
+
+/*
+ * Sets the color of the module at the given coordinates, false for white or true for black.
+ * Coordinates out of bounds are ignored. This does not keep the symbol well-formed,
+ * it is meant for restoring modules of a symbol that was made by the encoder.
+ */
+void qrcodegen_setModule(uint8_t qrcode[], int x, int y, bool isBlack);
@@ -0,0 +1,43 @@
+/*
+Queue of work deferred from the radio subscription handlers
+
+A handler only keeps what it received and pushes the work, the work runs from a scheduler task after the delay without
+a new push, that is after the radio receive window. Work that is already waiting is not pushed twice, it reads the newest
+data when it runs. The queue has a fixed capacity, a push to a full queue is refused.
+*/
+
+#ifndef _WORK_QUEUE_H
+#define _WORK_QUEUE_H
+
+#include <twr.h>
+
+#ifndef WORK_QUEUE_CAPACITY
+#define WORK_QUEUE_CAPACITY 8
+#endif
+
+typedef void (*work_queue_handler_t)(void *param);
+
+typedef struct
+{
+    work_queue_handler_t handler;
+    void *param;
+} work_queue_item_t;
+
+typedef struct
+{
+    work_queue_item_t items[WORK_QUEUE_CAPACITY];
+    int head;
+    int count;
+
+    twr_tick_t delay;
+    twr_scheduler_task_id_t task_id;
+
+    uint32_t done;
+    uint32_t merged;
+    uint32_t dropped;
+} work_queue_t;
+
+void work_queue_init(work_queue_t *self, twr_tick_t delay);
+bool work_queue_push(work_queue_t *self, work_queue_handler_t handler, void *param);
+
+#endif // _WORK_QUEUE_H
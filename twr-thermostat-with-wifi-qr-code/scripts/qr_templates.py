@@ -0,0 +1,210 @@
+"""
+Generator of the QR code function pattern templates in include/qrcodegen_templates.h
+
+For every version up to the maximum it emits two planes of modules in the row layout of qrcodegen.c: the reserved
+modules, where every function module is black, and the function patterns themselves without the format bits. The
+encoder copies them instead of drawing the finder, timing, alignment and version patterns on every encoding.
+
+PlatformIO runs it before the build (extra_scripts = pre:scripts/qr_templates.py) for QR_CODE_VERSION_MAX from the
+build flags, or DEFAULT_VERSION_MAX. It can also be run by hand:
+
+python3 qr_templates.py <max version> <output file>
+"""
+
+import os
+import sys
+
+# Default of QR_CODE_VERSION_MAX in src/application.c
+DEFAULT_VERSION_MAX = 6
+
+WORDS_PER_LINE = 6
+
+
+def get_alignment_pattern_positions(version):
+    if version == 1:
+        return []
+
+    count = version // 7 + 2
+    step = 26 if version == 32 else (version * 4 + count * 2 + 1) // (2 * count - 2) * 2
+    result = [version * 4 + 10 - i * step for i in range(count - 1)]
+
+    return [6] + result[::-1]
+
+
+def get_version_bits(version):
+    rem = version
+
+    for _ in range(12):
+        rem = (rem << 1) ^ ((rem >> 11) * 0x1F25)
+
+    return version << 12 | rem
+
+
+def make_planes(version):
+    """
+    Returns the reserved modules and the function patterns of the version as lists of rows of booleans
+    """
+    size = version * 4 + 17
+    reserved = [[False] * size for _ in range(size)]
+    pattern = [[False] * size for _ in range(size)]
+
+    def fill(left, top, width, height):
+        for y in range(top, top + height):
+            for x in range(left, left + width):
+                reserved[y][x] = True
+                pattern[y][x] = True
+
+    def draw(x, y, black):
+        if 0 <= x < size and 0 <= y < size:
+            pattern[y][x] = black
+
+    # Timing patterns, finder patterns with their separators and format bits
+    fill(6, 0, 1, size)
+    fill(0, 6, size, 1)
+    fill(0, 0, 9, 9)
+    fill(size - 8, 0, 8, 9)
+    fill(0, size - 8, 9, 8)
+
+    positions = get_alignment_pattern_positions(version)
+    last = len(positions) - 1
+    alignments = [(x, y) for i, x in enumerate(positions) for j, y in enumerate(positions)
+                  if (i, j) not in ((0, 0), (0, last), (last, 0))]
+
+    for x, y in alignments:
+        fill(x - 2, y - 2, 5, 5)
+
+    if version >= 7:
+        fill(size - 11, 0, 3, 6)
+        fill(0, size - 11, 6, 3)
+
+    # White modules, in the same order as drawWhiteFunctionModules() in qrcodegen.c
+    for i in range(7, size - 7, 2):
+        draw(6, i, False)
+        draw(i, 6, False)
+
+    for i in range(-4, 5):
+        for j in range(-4, 5):
+            if max(abs(i), abs(j)) in (2, 4):
+                draw(3 + j, 3 + i, False)
+                draw(size - 4 + j, 3 + i, False)
+                draw(3 + j, size - 4 + i, False)
+
+    for x, y in alignments:
+        for k in range(-1, 2):
+            for l in range(-1, 2):
+                draw(x + l, y + k, k == 0 and l == 0)
+
+    if version >= 7:
+        data = get_version_bits(version)
+
+        for i in range(6):
+            for j in range(3):
+                draw(size - 11 + j, i, data & 1 != 0)
+                draw(i, size - 11 + j, data & 1 != 0)
+                data >>= 1
+
+    return reserved, pattern
+
+
+def pack_rows(rows):
+    """
+    Packs the rows into 32-bit words, module x of a row is bit x % 32 of word x / 32 like in qrcodegen.c
+    """
+    words = []
+
+    for row in rows:
+        for start in range(0, len(row), 32):
+            words.append(sum(1 << i for i, black in enumerate(row[start:start + 32]) if black))
+
+    return words
+
+
+def format_words(words):
+    lines = []
+
+    for start in range(0, len(words), WORDS_PER_LINE):
+        lines.append("\t" + " ".join("0x%08X," % word for word in words[start:start + WORDS_PER_LINE]))
+
+    return "\n".join(lines)
+
+
+def generate(version_max):
+    offsets = [0]
+    reserved_words = []
+    pattern_words = []
+
+    for version in range(1, version_max + 1):
+        reserved, pattern = make_planes(version)
+        reserved_words += pack_rows(reserved)
+        pattern_words += pack_rows(pattern)
+        offsets.append(len(reserved_words))
+
+    return """/*
+ * QR Code function pattern templates, generated by scripts/qr_templates.py - do not edit.
+ * Included only by qrcodegen.c, which falls back to drawing the patterns above qrcodegen_TEMPLATE_VERSION_MAX.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define qrcodegen_TEMPLATE_VERSION_MAX  %d
+
+// Index of the first row word of each version in the planes, starting with version 1
+static const uint16_t qrcodegen_TEMPLATE_OFFSETS[qrcodegen_TEMPLATE_VERSION_MAX + 1] = {
+%s
+};
+
+// Reserved modules: every function module is black, including the format bits
+static const uint32_t qrcodegen_TEMPLATE_RESERVED[%d] = {
+%s
+};
+
+// Function patterns: finder, separator, timing, alignment and version modules in their colors,
+// the format bits are black until they are drawn
+static const uint32_t qrcodegen_TEMPLATE_PATTERNS[%d] = {
+%s
+};
+""" % (version_max, "\t" + " ".join("%d," % offset for offset in offsets), len(reserved_words),
+       format_words(reserved_words), len(pattern_words), format_words(pattern_words))
+
+
+def write_if_changed(path, text):
+    if os.path.exists(path):
+        with open(path, encoding="utf-8") as file:
+            if file.read() == text:
+                return
+
+    with open(path, "w", encoding="utf-8", newline="\n") as file:
+        file.write(text)
+
+
+def get_build_version_max(env):
+    flags = env.ParseFlags(env.GetProjectOption("build_flags", ""))
+
+    for define in flags.get("CPPDEFINES", []):
+        if isinstance(define, (list, tuple)) and define[0] == "QR_CODE_VERSION_MAX":
+            return int(define[1])
+
+    return DEFAULT_VERSION_MAX
+
+
+def main(argv):
+    if len(argv) != 3 or not argv[1].isdigit() or not 1 <= int(argv[1]) <= 40:
+        sys.stderr.write("Usage: %s <max version 1-40> <output file>\n" % argv[0])
+
+        return 1
+
+    write_if_changed(argv[2], generate(int(argv[1])))
+
+    return 0
+
+
+try:
+    Import("env")  # noqa: F821 - defined when PlatformIO runs this as an extra script
+except NameError:
+    if __name__ == "__main__":
+        sys.exit(main(sys.argv))
+else:
+    write_if_changed(os.path.join(env.subst("$PROJECT_INCLUDE_DIR"), "qrcodegen_templates.h"),  # noqa: F821
+                     generate(get_build_version_max(env)))  # noqa: F821
@@ -13,37 +13,230 @@ Date:   2.4.2021
 
 #include <application.h>
 #include <qrcodegen.h>
+#include <qr_bitmap.h>
+#include <lcd_widget.h>
+#include <lcd_diff.h>
+#include <lcd_snapshot.h>
+#include <eeprom_journal.h>
+#include <config_store.h>
+#include <heating_control.h>
+#include <work_queue.h>
+#include <report.h>
+#include <sampling.h>
 
 #define BATTERY_UPDATE_INTERVAL (60 * MINUTE)
 
+// Time the sleeping node listens after it sends, the work of the subscription handlers waits until it is over
+#define RADIO_RX_TIMEOUT 250
+
+// The page shows the published temperature, so a change is published without waiting
+#define TEMPERATURE_TAG_PUB_MIN_INTERVAL 0
 #define TEMPERATURE_TAG_PUB_NO_CHANGE_INTEVAL (10 * MINUTE)
-#define VALUE_CHANGE_PUB_TRESHOLD 0.2f
 
-#define EEPROM_SET_TEMPERATURE_ADDRESS 0
-#define BLACK_COLOR 1
+static const report_config_t temperature_report_config = { "temperature", 0.2f, 0.6f, TEMPERATURE_TAG_PUB_MIN_INTERVAL, TEMPERATURE_TAG_PUB_NO_CHANGE_INTEVAL };
+
+// The heating control needs the temperature at least once a minute, much less than its minimum on and off times
+#define TEMPERATURE_TAG_UPDATE_MIN_INTERVAL (10 * 1000)
+#define TEMPERATURE_TAG_UPDATE_MAX_INTERVAL (MINUTE)
+
+static const sampling_config_t temperature_sampling_config = { "tmp112", TEMPERATURE_TAG_UPDATE_MIN_INTERVAL, TEMPERATURE_TAG_UPDATE_MAX_INTERVAL };
+
+// EEPROM layout: the config store with room for more keys, the caches of the QR code symbol and page, and the set point journal
+#define EEPROM_CONFIG_ADDRESS 0
+#define EEPROM_CONFIG_SIZE 256
+#define EEPROM_QR_SYMBOL_ADDRESS (EEPROM_CONFIG_ADDRESS + EEPROM_CONFIG_SIZE)
+#define EEPROM_QR_SNAPSHOT_ADDRESS (EEPROM_QR_SYMBOL_ADDRESS + 2 * sizeof(uint32_t) + qrcodegen_BUFFER_LEN_FOR_VERSION(QR_CODE_VERSION_MAX))
+#define EEPROM_SET_POINT_JOURNAL_ADDRESS (EEPROM_QR_SNAPSHOT_ADDRESS + LCD_SNAPSHOT_EEPROM_SIZE)
+
+// The older firmware wrote both the QR code text and the set point with its inverted copy to address 0, they are read once to migrate them
+#define EEPROM_LEGACY_ADDRESS 0
+
+// Version of the config store layout, change it whenever the keys change in a way that the table does not show
+#define CONFIG_LAYOUT_VERSION 1
+
+// Slots of the set point journal and the time without a click after which the set point is written
+#define SET_POINT_JOURNAL_SLOTS 16
+#define SET_POINT_COMMIT_DELAY (5 * 1000)
+
+// Largest QR code version that is encoded, bigger symbols would not fit the display
+#ifndef QR_CODE_VERSION_MAX
+#define QR_CODE_VERSION_MAX 6
+#endif
+
+// Layout of the symbol buffer stored in the EEPROM, change it whenever the qrcodegen buffer format changes
+#define QR_SYMBOL_FORMAT 2
+
+// First display line below the title of the QR code page and the white border around the QR code in modules
+#define QR_CODE_TOP 16
+#define QR_CODE_BORDER 2
+
+// Display line in the LCD framebuffer: address byte, 128 pixels in 16 bytes and dummy byte, behind the mode byte
+#define LCD_LINE_PIXELS 128
+#define LCD_LINE_OFFSET(y) (2 + (y) * 18)
 
 #define SET_TEMPERATURE_PUB_INTERVAL 15 * MINUTE
 #define SET_TEMPERATURE_ADD_ON_CLICK 0.5f
+#define SET_TEMPERATURE_DEFAULT 21.0f
+
+// Range of the set point received over the radio, the same as the set point on the dashboard
+#define SET_TEMPERATURE_MIN 0.0f
+#define SET_TEMPERATURE_MAX 40.0f
+
+// Time without a click after which the set point is published, the clicks before it are published as one change
+#define SET_POINT_PUB_SETTLE_TIME 2000
+
+// Hysteresis band around the set point and the minimum times the heating stays on and off, they can be set in build_flags
+#ifndef HEATING_HYSTERESIS
+#define HEATING_HYSTERESIS 0.5f
+#endif
+
+#ifndef HEATING_MIN_ON_TIME
+#define HEATING_MIN_ON_TIME (3 * MINUTE)
+#endif
+
+#ifndef HEATING_MIN_OFF_TIME
+#define HEATING_MIN_OFF_TIME (3 * MINUTE)
+#endif
 
 // GFX instance
 twr_gfx_t *gfx;
 
-float displayed_temperature = NAN;
+// Sprites of the characters of the temperature and its unit, rasterised at boot. The fonts need about 700 bytes, a character
+// that does not fit is drawn by gfx and reported by glyph_font_init()
+#define GLYPH_DATA_SIZE 768
+
+static uint8_t glyph_data[GLYPH_DATA_SIZE];
+static lcd_glyph_font_t temperature_glyphs;
+static lcd_glyph_font_t unit_glyphs;
+
+// Widgets of the thermostat page, the unit follows the temperature
+enum
+{
+    THERMOSTAT_WIDGET_TEMPERATURE,
+    THERMOSTAT_WIDGET_UNIT,
+    THERMOSTAT_WIDGET_LABEL,
+    THERMOSTAT_WIDGET_SET_POINT,
+    THERMOSTAT_WIDGET_COUNT
+};
+
+static lcd_widget_t thermostat_widgets[THERMOSTAT_WIDGET_COUNT] = {
+    [THERMOSTAT_WIDGET_TEMPERATURE] = { .font = &twr_font_ubuntu_33, .glyphs = &temperature_glyphs, .left = 20, .top = 20, .height = 33 },
+    [THERMOSTAT_WIDGET_UNIT] = { .font = &twr_font_ubuntu_24, .glyphs = &unit_glyphs, .top = 25, .height = 24, .anchor = &thermostat_widgets[THERMOSTAT_WIDGET_TEMPERATURE], .gap = 4, .text = "\xb0" "C" },
+    [THERMOSTAT_WIDGET_LABEL] = { .font = &twr_font_ubuntu_15, .left = 10, .top = 80, .height = 15, .text = "Set temperature" },
+    [THERMOSTAT_WIDGET_SET_POINT] = { .font = &twr_font_ubuntu_15, .left = 40, .top = 100, .height = 15 }
+};
+
+static lcd_widget_page_t thermostat_page;
+
+// Rendered thermostat page while the QR code page is shown, kept in the shadow of lcd_diff, and the QR code page that stays
+// the same until the symbol changes
+static lcd_snapshot_t thermostat_snapshot;
+static lcd_snapshot_t qr_snapshot;
 
+// Published temperature, it is shown on the thermostat page
 temperature_params temperature_param = { .next_pub = 0, .value = NAN };
+static report_t temperature_report;
+static sampling_t temperature_sampling;
 temperature_params thermostat_set_point;
 
+static eeprom_journal_t set_point_journal;
+
+// Publication of the set point changed by the buttons, the clicks are the event count of the push button
+static twr_scheduler_task_id_t set_point_pub_task_id;
+static uint16_t set_point_click_count = 0;
+static uint16_t set_point_pub_click_count = 0;
+
+// Set point publications and the transmissions they saved, every click used to publish the set point and the push button
+static uint32_t set_point_pub_count = 0;
+static uint32_t set_point_pub_saved_count = 0;
+
+// Heating controlled from the last temperature reading, the published temperature lags behind it by up to the deadband
+static heating_control_t heating_control;
+static float heating_temperature = NAN;
+
 // QR code data values
 char qr_code[150];
 
+enum
+{
+    CONFIG_KEY_QR_CODE,
+    CONFIG_KEY_COUNT
+};
+
+static const char qr_code_default[sizeof(qr_code)] = "WIFI:S:test;T:test;P:test;;";
+
+static const config_store_key_t config_keys[CONFIG_KEY_COUNT] = {
+    [CONFIG_KEY_QR_CODE] = { .type = CONFIG_STORE_TYPE_STRING, .size = sizeof(qr_code), .default_value = qr_code_default }
+};
+
+static config_store_t config;
+
+// Encoded QR code symbol, valid until the QR code data values change
+static uint8_t qr_symbol[qrcodegen_BUFFER_LEN_FOR_VERSION(QR_CODE_VERSION_MAX)] __attribute__((aligned(4)));
+static bool qr_symbol_valid = false;
+
+// Working buffer of the QR code encoder and the bitmap decoder
+static uint8_t qr_temp[qrcodegen_BUFFER_LEN_FOR_VERSION(QR_CODE_VERSION_MAX)] __attribute__((aligned(4)));
+
+// Base64 text of the QR code bitmap that is being received
+static char qr_bitmap_text[QR_BITMAP_BASE64_LEN(QR_BITMAP_STREAM_LEN_MAX(QR_CODE_VERSION_MAX)) + 1];
+static size_t qr_bitmap_received = 0;
+
+// Length of the complete bitmap waiting for its work, no part is taken until it is decoded, a newer QR code text clears it
+static size_t qr_bitmap_complete = 0;
+
+// QR code text received over the radio waiting for its work, a newer complete bitmap cancels it
+static char qr_code_received[sizeof(qr_code)];
+static bool qr_code_pending = false;
+
+// Set point received over the radio waiting for its work
+static float set_point_received;
+
+// Work of the subscription handlers, run after the radio receive window
+static work_queue_t work_queue;
+
 // Custom MQTT topic for getting the QR code data
 static const twr_radio_sub_t subs[] = {
-    {"qr/-/chng/code", TWR_RADIO_SUB_PT_STRING, twr_change_qr_value, (void *) PASSWD}
+    {"qr/-/chng/code", TWR_RADIO_SUB_PT_STRING, twr_change_qr_value, (void *) PASSWD},
+    {"qr/-/chng/bitmap", TWR_RADIO_SUB_PT_STRING, twr_change_qr_bitmap, NULL},
+    {"thermostat/-/set-point/set", TWR_RADIO_SUB_PT_FLOAT, twr_change_set_point, NULL}
 };
 
 uint32_t display_page_index = 0;
 twr_tmp112_t temp;
 
+/*
+This function will write the temperature with one decimal place, it needs LCD_GLYPH_TENTHS_SIZE bytes
+*/
+static void format_temperature(char *text, float temperature)
+{
+    if (isnan(temperature))
+    {
+        strcpy(text, "nan");
+
+        return;
+    }
+
+    lcd_glyph_format_tenths(text, (int32_t) (temperature * 10.0f + (temperature < 0 ? -0.5f : 0.5f)));
+}
+
+/*
+This function will put the current temperature and set point into the widgets of the thermostat page
+
+Only the widgets whose text changed are redrawn, so the temperature is redrawn when its rounded value changes
+*/
+static void thermostat_page_update(void)
+{
+    char text[LCD_GLYPH_TENTHS_SIZE + 4];
+
+    format_temperature(text, temperature_param.value);
+    lcd_widget_set_text(&thermostat_page, &thermostat_widgets[THERMOSTAT_WIDGET_TEMPERATURE], text);
+
+    format_temperature(text, thermostat_set_point.value);
+    strcat(text, " \xb0" "C");
+    lcd_widget_set_text(&thermostat_page, &thermostat_widgets[THERMOSTAT_WIDGET_SET_POINT], text);
+}
+
 /*
 Event handler for the Battery module
 
@@ -65,6 +258,22 @@ void battery_event_handler(twr_module_battery_event_t event, void *event_param)
     }
 }
 
+/*
+This function will let the controller decide the heating and publish its state when it changed
+*/
+static void heating_update(void)
+{
+    if (heating_control_update(&heating_control, heating_temperature, thermostat_set_point.value))
+    {
+        bool heating = heating_control_get_state(&heating_control);
+
+        twr_radio_pub_bool("thermostat/-/heating/state", &heating);
+
+        twr_log_debug("$HEATING: %s at %.2f, set point %.1f, %lu switches, %lu held back", heating ? "on" : "off", heating_temperature,
+                      thermostat_set_point.value, (unsigned long) heating_control.switches, (unsigned long) heating_control.held_back);
+    }
+}
+
 /*
 Event handler for the Temperature sensor
 
@@ -79,18 +288,27 @@ void tmp112_event_handler(twr_tmp112_t *self, twr_tmp112_event_t event, void *ev
 
         if (twr_tmp112_get_temperature_celsius(self, &temperature))
         {
-            if ((fabsf(temperature - temperature_param.value) >= VALUE_CHANGE_PUB_TRESHOLD) || (temperature_param.next_pub < twr_scheduler_get_spin_tick()))
+            heating_temperature = temperature;
+
+            if (report_update(&temperature_report, temperature))
             {
                 twr_radio_pub_temperature(TWR_RADIO_PUB_CHANNEL_R1_I2C0_ADDRESS_ALTERNATE, &temperature);
                 temperature_param.value = temperature;
-                temperature_param.next_pub = twr_scheduler_get_spin_tick() + TEMPERATURE_TAG_PUB_NO_CHANGE_INTEVAL;
+            }
+
+            if (sampling_update(&temperature_sampling, temperature, report_get_deadband(&temperature_report)))
+            {
+                twr_tmp112_set_update_interval(self, sampling_get_interval(&temperature_sampling));
             }
         }
         else
         {
             temperature_param.value = NAN;
+            heating_temperature = NAN;
         }
 
+        heating_update();
+
         if (thermostat_set_point.next_pub < twr_scheduler_get_spin_tick())
         {
             thermostat_set_point.next_pub = twr_scheduler_get_spin_tick() + SET_TEMPERATURE_PUB_INTERVAL;
@@ -98,25 +316,269 @@ void tmp112_event_handler(twr_tmp112_t *self, twr_tmp112_event_t event, void *ev
             twr_radio_pub_temperature(TWR_RADIO_PUB_CHANNEL_SET_POINT, &thermostat_set_point.value);
         }
 
-        if ((fabsf(temperature_param.value - displayed_temperature) >= 0.1) || isnan(displayed_temperature))
-        {
-            twr_scheduler_plan_now(0);
-        }
+        thermostat_page_update();
+    }
+}
+
+/*
+Work of a new QR code value, it takes the value, stores it and redraws the QR code page, which encodes the new symbol
+*/
+static void qr_code_work(void *param)
+{
+    (void) param;
+
+    // A bitmap completed after the value replaced it
+    if (!qr_code_pending)
+    {
+        return;
+    }
+
+    qr_code_pending = false;
+
+    strcpy(qr_code, qr_code_received);
+    qr_symbol_valid = false;
+
+    config_store_set_string(&config, CONFIG_KEY_QR_CODE, qr_code);
+
+    if (display_page_index == 1)
+    {
+        twr_scheduler_plan_now(0);
     }
 }
 
 /*
 This function will be called when the message on a custom topic is received and it will change the QR code value
+
+The value is ignored if it does not fit into a QR code of QR_CODE_VERSION_MAX in a single mode, the mixed mode encoding of
+qrcode_handler never needs a larger symbol. The value waits for qr_code_work and cancels a complete bitmap that is still
+waiting for its work, so the last of the QR code messages wins.
 */
 void twr_change_qr_value(uint64_t *id, const char *topic, void *value, void *param)
 {
-    strncpy(qr_code, value, sizeof(qr_code));
-    char ch = ';';
-    strncat(qr_code, &ch, 1);
+    char text[sizeof(qr_code)];
+
+    strncpy(text, value, sizeof(text) - 2);
+    text[sizeof(text) - 2] = '\0';
+    strcat(text, ";");
+
+    if (qrcodegen_getMinVersionForText(text, qrcodegen_Ecc_LOW, qrcodegen_VERSION_MIN, QR_CODE_VERSION_MAX) == 0)
+    {
+        twr_log_warning("QR code value too long");
+
+        return;
+    }
+
+    strcpy(qr_code_received, text);
+    qr_code_pending = true;
+    qr_bitmap_complete = 0;
+
+    work_queue_push(&work_queue, qr_code_work, NULL);
+}
+
+/*
+Simple FNV-1a hash of the data
+*/
+static uint32_t fnv_hash(const void *data, size_t length)
+{
+    const uint8_t *bytes = data;
+    uint32_t hash = 2166136261;
+
+    while (length-- > 0)
+    {
+        hash ^= *bytes++;
+        hash *= 16777619;
+    }
+
+    return hash;
+}
+
+/*
+Hash of the QR code text, it binds the symbol stored in the EEPROM to the text it was encoded from
+*/
+static uint32_t qr_code_hash(const char *text)
+{
+    return fnv_hash(text, strlen(text));
+}
+
+/*
+This function will store the encoded QR code symbol to the EEPROM right behind the QR code text
+
+Only the used part of the symbol buffer is written, prefixed by the hash of the text and the buffer format
+*/
+static void qr_symbol_save(const char *text)
+{
+    uint32_t header[2] = { qr_code_hash(text), QR_SYMBOL_FORMAT };
+    size_t length = qrcodegen_BUFFER_LEN_FOR_VERSION((qrcodegen_getSize(qr_symbol) - 17) / 4);
+
+    if (EEPROM_QR_SYMBOL_ADDRESS + sizeof(header) + length > twr_eeprom_get_size())
+    {
+        return;
+    }
+
+    twr_eeprom_write(EEPROM_QR_SYMBOL_ADDRESS + sizeof(header), qr_symbol, length);
+    twr_eeprom_write(EEPROM_QR_SYMBOL_ADDRESS, header, sizeof(header));
+}
+
+/*
+This function will load the encoded QR code symbol from the EEPROM
+
+The symbol is used only if it was encoded from the same text, so a cold boot does not need to run the encoder
+*/
+static void qr_symbol_load(const char *text)
+{
+    uint32_t header[2];
+
+    qr_symbol_valid = false;
+
+    twr_eeprom_read(EEPROM_QR_SYMBOL_ADDRESS, header, sizeof(header));
+
+    if (header[0] != qr_code_hash(text) || header[1] != QR_SYMBOL_FORMAT)
+    {
+        return;
+    }
+
+    twr_eeprom_read(EEPROM_QR_SYMBOL_ADDRESS + sizeof(header), qr_symbol, 1);
+
+    int size = qr_symbol[0];
+
+    if (size < qrcodegen_VERSION_MIN * 4 + 17 || size > QR_CODE_VERSION_MAX * 4 + 17 || (size - 17) % 4 != 0)
+    {
+        return;
+    }
+
+    twr_eeprom_read(EEPROM_QR_SYMBOL_ADDRESS + sizeof(header), qr_symbol, qrcodegen_BUFFER_LEN_FOR_VERSION((size - 17) / 4));
+
+    qr_symbol_valid = true;
+}
+
+/*
+Work of a complete QR code bitmap, it decodes the bitmap into the symbol, stores it and redraws the QR code page
+*/
+static void qr_bitmap_work(void *param)
+{
+    (void) param;
+
+    // A QR code text received after the bitmap replaced it
+    if (qr_bitmap_complete == 0)
+    {
+        return;
+    }
+
+    // The stream is decoded over its own base64 text
+    uint8_t *stream = (uint8_t *) qr_bitmap_text;
+    size_t stream_length;
+    bool decoded = qr_bitmap_base64_decode(qr_bitmap_text, qr_bitmap_complete, stream, &stream_length) && qr_bitmap_decode(stream, stream_length, qr_temp, QR_CODE_VERSION_MAX);
+
+    qr_bitmap_complete = 0;
+
+    if (!decoded)
+    {
+        twr_log_warning("QR code bitmap damaged");
+
+        return;
+    }
+
+    memcpy(qr_symbol, qr_temp, sizeof(qr_symbol));
+    qr_symbol_valid = true;
+
+    qr_code[0] = '\0';
+    config_store_set_string(&config, CONFIG_KEY_QR_CODE, qr_code);
+
+    qr_symbol_save(qr_code);
+
+    if (display_page_index == 1)
+    {
+        twr_scheduler_plan_now(0);
+    }
+}
+
+/*
+This function will be called when a part of the QR code bitmap made by the gateway is received
+
+Every part is "<total length>,<offset>:<base64 text>", the part at offset 0 starts a new bitmap and the other parts must follow in order.
+The complete bitmap replaces the QR code symbol in qr_bitmap_work, so the thermostat does not need to run the encoder at all.
+The QR code text is cleared at the same time, the empty text marks the symbol received as a bitmap in the EEPROM. A complete
+bitmap cancels a QR code text that is still waiting for its work, so the last of the QR code messages wins.
+*/
+void twr_change_qr_bitmap(uint64_t *id, const char *topic, void *value, void *param)
+{
+    char *end;
+    unsigned long total = strtoul(value, &end, 10);
+    unsigned long offset;
 
-    twr_eeprom_write(0, qr_code, sizeof(qr_code));
+    if (*end != ',')
+    {
+        return;
+    }
+
+    offset = strtoul(end + 1, &end, 10);
+
+    if (*end != ':')
+    {
+        return;
+    }
+
+    char *part = end + 1;
+    size_t length = strlen(part);
+
+    if (qr_bitmap_complete != 0)
+    {
+        twr_log_warning("QR code bitmap busy");
+
+        return;
+    }
+
+    if (offset == 0)
+    {
+        qr_bitmap_received = 0;
+    }
+
+    if (offset != qr_bitmap_received || total >= sizeof(qr_bitmap_text) || offset + length > total)
+    {
+        qr_bitmap_received = 0;
+
+        return;
+    }
+
+    memcpy(&qr_bitmap_text[offset], part, length);
+    qr_bitmap_received += length;
+
+    if (qr_bitmap_received < total)
+    {
+        return;
+    }
+
+    qr_bitmap_received = 0;
+    qr_bitmap_complete = total;
+    qr_code_pending = false;
+
+    work_queue_push(&work_queue, qr_bitmap_work, NULL);
 }
 
+/*
+This function will make the pixels from x0 to x1 - 1 of the line black
+
+The line is stored in 32-bit words with the leftmost pixel in the most significant bit, a white pixel is 1 and a black one is 0 like in the LCD framebuffer
+*/
+static void lcd_line_fill_black(uint32_t *line, int x0, int x1)
+{
+    while (x0 < x1)
+    {
+        int bit = x0 & 31;
+        int count = (x1 - x0 < 32 - bit) ? x1 - x0 : 32 - bit;
+        uint32_t mask = (count == 32) ? UINT32_MAX : ((UINT32_C(1) << count) - 1) << (32 - bit - count);
+
+        line[x0 >> 5] &= ~mask;
+        x0 += count;
+    }
+}
+
+/*
+This function will draw the QR code page
+
+Every QR code row is turned into runs of black modules, the runs are scaled into one display line and the line is copied to the LCD framebuffer once per display line it covers.
+The box size is the largest one that fits the display together with the border. The QR code is written to the framebuffer directly, so it relies on the display not being rotated.
+*/
 static void print_qr(const uint8_t qrcode[])
 {
     twr_gfx_clear(gfx);
@@ -124,22 +586,133 @@ static void print_qr(const uint8_t qrcode[])
     twr_gfx_set_font(gfx, &twr_font_ubuntu_13);
     twr_gfx_draw_string(gfx, 2, 0, "Scan and connect", true);
 
-    uint32_t offset_x = 8;
-    uint32_t offset_y = 32;
-    uint32_t box_size = 3;
-	int size = qrcodegen_getSize(qrcode);
-	int border = 2;
-	for (int y = -border; y < size + border; y++) {
-		for (int x = -border; x < size + border; x++) {
-            uint32_t x1 = offset_x + x * box_size;
-            uint32_t y1 = offset_y + y * box_size;
-            uint32_t x2 = x1 + box_size;
-            uint32_t y2 = y1 + box_size;
-
-            twr_gfx_draw_fill_rectangle(gfx, x1, y1, x2, y2, qrcodegen_getModule(qrcode, x, y));
-		}
-	}
-    twr_gfx_update(gfx);
+    twr_gfx_caps_t caps = twr_gfx_get_caps(gfx);
+    int size = qrcodegen_getSize(qrcode);
+    int width = caps.width < LCD_LINE_PIXELS ? caps.width : LCD_LINE_PIXELS;
+    int height = caps.height - QR_CODE_TOP;
+    int box_size = (width < height ? width : height) / (size + 2 * QR_CODE_BORDER);
+
+    if (box_size > 0)
+    {
+        // The border is left white by the clear above, only the modules are drawn
+        int offset_x = (width - size * box_size) / 2;
+        int offset_y = QR_CODE_TOP + (height - size * box_size) / 2;
+        uint8_t *framebuffer = ((twr_ls013b7dh03_t *) gfx->_display)->_framebuffer;
+        uint32_t line[LCD_LINE_PIXELS / 32];
+        uint8_t line_bytes[LCD_LINE_PIXELS / 8];
+
+        for (int y = 0; y < size; y++)
+        {
+            memset(line, 0xff, sizeof(line));
+
+            for (int x = 0; x < size; x++)
+            {
+                if (qrcodegen_getModule(qrcode, x, y))
+                {
+                    int start = x;
+
+                    while (x + 1 < size && qrcodegen_getModule(qrcode, x + 1, y))
+                    {
+                        x++;
+                    }
+
+                    lcd_line_fill_black(line, offset_x + start * box_size, offset_x + (x + 1) * box_size);
+                }
+            }
+
+            for (size_t i = 0; i < sizeof(line_bytes); i++)
+            {
+                line_bytes[i] = line[i / 4] >> (24 - 8 * (i % 4));
+            }
+
+            for (int i = 0; i < box_size; i++)
+            {
+                memcpy(&framebuffer[LCD_LINE_OFFSET(offset_y + y * box_size + i)], line_bytes, sizeof(line_bytes));
+            }
+        }
+    }
+}
+
+/*
+This function will publish the set point after the clicks settled, flagged as changed by the user with the push button event count
+*/
+static void set_point_pub_task(void *param)
+{
+    (void) param;
+
+    uint16_t clicks = set_point_click_count - set_point_pub_click_count;
+
+    thermostat_set_point.next_pub = twr_scheduler_get_spin_tick() + SET_TEMPERATURE_PUB_INTERVAL;
+    twr_radio_pub_temperature(TWR_RADIO_PUB_CHANNEL_SET_POINT, &thermostat_set_point.value);
+    twr_radio_pub_push_button(&set_point_click_count);
+
+    set_point_pub_click_count = set_point_click_count;
+    set_point_pub_count++;
+    set_point_pub_saved_count += 2 * (clicks - 1);
+
+    twr_log_debug("$SET-POINT: %.1f published after %u clicks, %lu publications, %lu transmissions saved", thermostat_set_point.value,
+                  clicks, (unsigned long) set_point_pub_count, (unsigned long) set_point_pub_saved_count);
+
+    heating_update();
+}
+
+/*
+This function will change the set point by the step of a click, it is written to the journal and published once the clicks settle
+*/
+static void set_point_change(float step)
+{
+    thermostat_set_point.value += step;
+    set_point_click_count++;
+
+    // The periodic publication must not send a value between the clicks
+    thermostat_set_point.next_pub = twr_scheduler_get_spin_tick() + SET_TEMPERATURE_PUB_INTERVAL;
+
+    eeprom_journal_set(&set_point_journal, thermostat_set_point.value);
+    twr_scheduler_plan_relative(set_point_pub_task_id, SET_POINT_PUB_SETTLE_TIME);
+
+    thermostat_page_update();
+}
+
+/*
+Work of a set point received over the radio, it is published back right away and a value equal to the current set point is ignored
+so it does not echo
+*/
+static void set_point_work(void *param)
+{
+    (void) param;
+
+    if (set_point_received == thermostat_set_point.value)
+    {
+        return;
+    }
+
+    thermostat_set_point.value = set_point_received;
+    thermostat_set_point.next_pub = twr_scheduler_get_spin_tick() + SET_TEMPERATURE_PUB_INTERVAL;
+    twr_radio_pub_temperature(TWR_RADIO_PUB_CHANNEL_SET_POINT, &thermostat_set_point.value);
+
+    eeprom_journal_set(&set_point_journal, thermostat_set_point.value);
+
+    thermostat_page_update();
+    heating_update();
+}
+
+/*
+This function will be called when the message on a custom topic is received and it will change the set point from the dashboard
+*/
+void twr_change_set_point(uint64_t *id, const char *topic, void *value, void *param)
+{
+    float set_point = *(float *) value;
+
+    if (isnan(set_point) || set_point < SET_TEMPERATURE_MIN || set_point > SET_TEMPERATURE_MAX)
+    {
+        twr_log_warning("Set point out of range");
+
+        return;
+    }
+
+    set_point_received = set_point;
+
+    work_queue_push(&work_queue, set_point_work, NULL);
 }
 
 /*
@@ -148,7 +721,8 @@ Event handler for the LCD module
 This function will taky care of all the LCD operations. Mostly it handles the button presses.
 
 On left button click it will decrease the set point temperature by static value
-On left button click it will increase the set point temperature by static value
+On right button click it will increase the set point temperature by static value
+The set point is published once the clicks settle
 
 On right button hold it will change the page on display
 
@@ -176,68 +750,128 @@ void lcd_event_handler(twr_module_lcd_event_t event, void *event_param)
     {
         if(display_page_index == 0)
         {
-            thermostat_set_point.value -= SET_TEMPERATURE_ADD_ON_CLICK;
+            set_point_change(-SET_TEMPERATURE_ADD_ON_CLICK);
+        }
+    }
+    else if(event == TWR_MODULE_LCD_EVENT_RIGHT_CLICK)
+    {
+        if(display_page_index == 0)
+        {
+            set_point_change(SET_TEMPERATURE_ADD_ON_CLICK);
+        }
+    }
+}
 
-            thermostat_set_point.next_pub = twr_scheduler_get_spin_tick() + SET_TEMPERATURE_PUB_INTERVAL;
-            twr_radio_pub_temperature(TWR_RADIO_PUB_CHANNEL_SET_POINT, &thermostat_set_point.value);
+/*
+This function will print the QR code to the display
 
-            uint32_t neg_set_temperature;
-            float *set_temperature = (float *) &neg_set_temperature;
+The QR code encoder is called only when the cached symbol is not valid, that is after the QR code data values changed.
+The page is drawn only when the snapshot in the EEPROM does not show the same symbol, otherwise the snapshot is copied to the framebuffer.
+*/
+void qrcode_handler(char *text)
+{
+    twr_system_pll_enable();
 
-            *set_temperature = thermostat_set_point.value;
+    if (!qr_symbol_valid)
+    {
+        // Make the QR Code symbol
+        qr_symbol_valid = qrcodegen_encodeTextOptimal(text, qr_temp, qr_symbol, qrcodegen_Ecc_LOW, qrcodegen_VERSION_MIN, QR_CODE_VERSION_MAX, qrcodegen_Mask_AUTO, true);
 
-            neg_set_temperature = ~neg_set_temperature;
+        if (qr_symbol_valid)
+        {
+            qr_symbol_save(text);
+        }
+    }
 
-            twr_eeprom_write(EEPROM_SET_TEMPERATURE_ADDRESS, &thermostat_set_point.value, sizeof(thermostat_set_point.value));
-            twr_eeprom_write(EEPROM_SET_TEMPERATURE_ADDRESS + sizeof(thermostat_set_point.value), &neg_set_temperature, sizeof(neg_set_temperature));
+    if (qr_symbol_valid)
+    {
+        uint32_t tag = fnv_hash(qr_symbol, qrcodegen_BUFFER_LEN_FOR_VERSION((qrcodegen_getSize(qr_symbol) - 17) / 4));
 
-            twr_scheduler_plan_now(0);
-            twr_radio_pub_push_button(0);
+        if (!lcd_snapshot_restore(&qr_snapshot, gfx, tag))
+        {
+            print_qr(qr_symbol);
+            lcd_snapshot_save(&qr_snapshot, gfx, tag);
         }
+
+        lcd_diff_update(gfx);
     }
-    else if(event == TWR_MODULE_LCD_EVENT_RIGHT_CLICK)
+
+    twr_system_pll_disable();
+}
+
+/*
+This function will load the set point from the newest record of the journal
+
+Without a record the set point of the older firmware is taken if its inverted copy matches, and written to the journal right away.
+The old location is not written any more, it overlaps the QR code text.
+*/
+static void set_point_load(void)
+{
+    uint32_t legacy[2];
+
+    if (eeprom_journal_init(&set_point_journal, EEPROM_SET_POINT_JOURNAL_ADDRESS, SET_POINT_JOURNAL_SLOTS, SET_POINT_COMMIT_DELAY, &thermostat_set_point.value))
     {
-        if(display_page_index == 0)
-        {
-            thermostat_set_point.value += SET_TEMPERATURE_ADD_ON_CLICK;
+        return;
+    }
 
-            thermostat_set_point.next_pub = bc_scheduler_get_spin_tick() + SET_TEMPERATURE_PUB_INTERVAL;
-            twr_radio_pub_temperature(TWR_RADIO_PUB_CHANNEL_SET_POINT, &thermostat_set_point.value);
+    thermostat_set_point.value = SET_TEMPERATURE_DEFAULT;
 
-            uint32_t neg_set_temperature;
-            float *set_temperature = (float *) &neg_set_temperature;
+    twr_eeprom_read(EEPROM_LEGACY_ADDRESS, legacy, sizeof(legacy));
 
-            *set_temperature = thermostat_set_point.value;
+    if (legacy[1] == ~legacy[0])
+    {
+        float value;
 
-            neg_set_temperature = ~neg_set_temperature;
+        memcpy(&value, &legacy[0], sizeof(value));
 
-            twr_eeprom_write(EEPROM_SET_TEMPERATURE_ADDRESS, &thermostat_set_point.value, sizeof(thermostat_set_point.value));
-            twr_eeprom_write(EEPROM_SET_TEMPERATURE_ADDRESS + sizeof(thermostat_set_point.value), &neg_set_temperature, sizeof(neg_set_temperature));
+        if (isfinite(value))
+        {
+            thermostat_set_point.value = value;
 
-            twr_scheduler_plan_now(0);
-            twr_radio_pub_push_button(0);
+            eeprom_journal_set(&set_point_journal, value);
+            eeprom_journal_commit(&set_point_journal);
         }
     }
 }
 
 /*
-This function will call the qr code encoder and then print the QR code to the display
+This function will load the QR code text from the config store
+
+Without the layout the QR code text of the older firmware is taken over before the layout replaces it at address 0, the set point
+was taken from there by set_point_load already
 */
-void qrcode_handler(char *text)
+static void config_load(void)
 {
-    twr_system_pll_enable();
+    if (!config_store_init(&config, EEPROM_CONFIG_ADDRESS, CONFIG_LAYOUT_VERSION, config_keys, CONFIG_KEY_COUNT))
+    {
+        twr_eeprom_read(EEPROM_LEGACY_ADDRESS, qr_code, sizeof(qr_code));
+        qr_code[sizeof(qr_code) - 1] = '\0';
 
-	// Make and print the QR Code symbol
-	uint8_t qrcode[qrcodegen_BUFFER_LEN_MAX];
-	uint8_t tempBuffer[qrcodegen_BUFFER_LEN_MAX];
-	bool ok = qrcodegen_encodeText(text, tempBuffer, qrcode, qrcodegen_Ecc_LOW,	qrcodegen_VERSION_MIN, qrcodegen_VERSION_MAX, qrcodegen_Mask_AUTO, true);
+        config_store_format(&config);
 
-	if (ok)
+        if (strstr(qr_code, "WIFI:S:") != NULL)
+        {
+            config_store_set_string(&config, CONFIG_KEY_QR_CODE, qr_code);
+        }
+    }
+
+    config_store_get_string(&config, CONFIG_KEY_QR_CODE, qr_code, sizeof(qr_code));
+}
+
+/*
+This function will rasterise the sprites of the characters behind the used part of the glyph data and return the new used size,
+it warns when a character did not fit
+*/
+static size_t glyph_font_init(lcd_glyph_font_t *glyphs, const twr_font_t *font, const char *charset, size_t used)
+{
+    used += lcd_glyph_font_init(glyphs, gfx, font, charset, &glyph_data[used], sizeof(glyph_data) - used);
+
+    if (glyphs->count != strlen(charset))
     {
-		print_qr(qrcode);
+        twr_log_warning("Glyph data too small, %u of %u characters", (unsigned) glyphs->count, (unsigned) strlen(charset));
     }
 
-    twr_system_pll_disable();
+    return used;
 }
 
 /*
@@ -251,35 +885,45 @@ void application_init(void)
     twr_radio_init(TWR_RADIO_MODE_NODE_SLEEPING);
 
     twr_radio_set_subs((twr_radio_sub_t *) subs, sizeof(subs)/sizeof(twr_radio_sub_t));
-    twr_radio_set_rx_timeout_for_sleeping_node(250);
-
-    uint32_t neg_set_temperature;
-    float *set_temperature = (float *) &neg_set_temperature;
+    twr_radio_set_rx_timeout_for_sleeping_node(RADIO_RX_TIMEOUT);
 
-    twr_eeprom_read(EEPROM_SET_TEMPERATURE_ADDRESS, &thermostat_set_point.value, sizeof(thermostat_set_point.value));
-    twr_eeprom_read(EEPROM_SET_TEMPERATURE_ADDRESS + sizeof(thermostat_set_point.value), &thermostat_set_point, sizeof(neg_set_temperature));
+    work_queue_init(&work_queue, RADIO_RX_TIMEOUT);
 
-    neg_set_temperature = ~neg_set_temperature;
-
-    if (thermostat_set_point.value != *set_temperature)
-    {
-        thermostat_set_point.value = 21.0f;
-    }
+    set_point_load();
+    set_point_pub_task_id = twr_scheduler_register(set_point_pub_task, NULL, TWR_TICK_INFINITY);
+    heating_control_init(&heating_control, HEATING_HYSTERESIS, HEATING_MIN_ON_TIME, HEATING_MIN_OFF_TIME);
 
     twr_module_lcd_init();
     gfx = twr_module_lcd_get_gfx();
     twr_module_lcd_set_event_handler(lcd_event_handler, NULL);
     twr_module_lcd_set_button_hold_time(500);
 
+    size_t glyph_data_used = glyph_font_init(&temperature_glyphs, &twr_font_ubuntu_33, "0123456789.-", 0);
+    glyph_data_used = glyph_font_init(&unit_glyphs, &twr_font_ubuntu_24, "\xb0" "C", glyph_data_used);
+    twr_log_debug("$GLYPH: %u of %u B", (unsigned) glyph_data_used, (unsigned) sizeof(glyph_data));
+
+    lcd_widget_page_init(&thermostat_page, gfx, thermostat_widgets, THERMOSTAT_WIDGET_COUNT);
+    lcd_snapshot_init_shadow(&thermostat_snapshot);
+    lcd_widget_page_set_snapshot(&thermostat_page, &thermostat_snapshot);
+    lcd_snapshot_init_eeprom(&qr_snapshot, EEPROM_QR_SNAPSHOT_ADDRESS);
+
+    report_init(&temperature_report, &temperature_report_config);
+    sampling_init(&temperature_sampling, &temperature_sampling_config);
+
     twr_tmp112_init(&temp, TWR_I2C_I2C0, TWR_TAG_TEMPERATURE_I2C_ADDRESS_ALTERNATE);
     twr_tmp112_set_event_handler(&temp, tmp112_event_handler, NULL);
-    twr_tmp112_set_update_interval(&temp, 10 * 1000);
+    twr_tmp112_set_update_interval(&temp, sampling_get_interval(&temperature_sampling));
+
+    config_load();
 
-    twr_eeprom_read(0, qr_code, sizeof(qr_code));
+    qr_symbol_load(qr_code);
 
-    if(strstr(qr_code, "WIFI:S:") == NULL)
+    // A symbol received as a bitmap is stored with an empty text
+    if(!qr_symbol_valid && (strstr(qr_code, "WIFI:S:") == NULL || qrcodegen_getMinVersionForText(qr_code, qrcodegen_Ecc_LOW, qrcodegen_VERSION_MIN, QR_CODE_VERSION_MAX) == 0))
     {
-        strncpy(qr_code, "WIFI:S:test;T:test;P:test;;", sizeof(qr_code));
+        strcpy(qr_code, qr_code_default);
+
+        qr_symbol_load(qr_code);
     }
 
     twr_module_battery_init();
@@ -292,45 +936,18 @@ void application_init(void)
 /*
 This function will run in a loop for the whole duration of the app.
 
-It will take care of redrawing the data on the LCD display and changing the pages
+It will take care of changing the pages, the thermostat page redraws its changed widgets by itself and the QR code page is drawn here
 */
 void application_task(void)
 {
     if(display_page_index == 0)
     {
-        static char str_temperature[10];
-
-        if (!twr_module_lcd_is_ready())
-        {
-            return;
-        }
-
-        twr_system_pll_enable();
-
-        twr_module_lcd_clear();
-
-        twr_gfx_clear(gfx);
-
-        twr_module_lcd_set_font(&twr_font_ubuntu_33);
-        snprintf(str_temperature, sizeof(str_temperature), "%.1f   ", temperature_param.value);
-        int x = twr_module_lcd_draw_string(20, 20, str_temperature, BLACK_COLOR);
-        displayed_temperature = temperature_param.value;
-
-        twr_module_lcd_set_font(&twr_font_ubuntu_24);
-        twr_module_lcd_draw_string(x - 20, 25, "\xb0" "C   ", BLACK_COLOR);
-
-        twr_module_lcd_set_font(&twr_font_ubuntu_15);
-        twr_module_lcd_draw_string(10, 80, "Set temperature", BLACK_COLOR);
-
-        snprintf(str_temperature, sizeof(str_temperature), "%.1f \xb0" "C", thermostat_set_point.value);
-        twr_module_lcd_draw_string(40, 100, str_temperature, BLACK_COLOR);
-
-        twr_module_lcd_update();
-
-        twr_system_pll_disable();
+        thermostat_page_update();
+        lcd_widget_page_show(&thermostat_page);
     }
     if(display_page_index == 1)
     {
+        lcd_widget_page_hide(&thermostat_page);
         qrcode_handler(qr_code);
     }
 }
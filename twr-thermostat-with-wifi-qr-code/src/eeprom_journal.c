@@ -0,0 +1,141 @@
+/*
+Journal of a float value in a ring of EEPROM records
+*/
+
+#include <eeprom_journal.h>
+#include <string.h>
+
+typedef struct
+{
+    uint16_t sequence;
+    uint16_t crc;
+    float value;
+} eeprom_journal_record_t;
+
+static void eeprom_journal_task(void *param);
+
+/*
+CRC16-CCITT of the sequence number and the value, an erased record of zeros does not match it
+*/
+static uint16_t eeprom_journal_crc(const eeprom_journal_record_t *record)
+{
+    uint8_t data[2 + sizeof(float)];
+    uint16_t crc = 0xffff;
+
+    memcpy(data, &record->sequence, 2);
+    memcpy(&data[2], &record->value, sizeof(float));
+
+    for (size_t i = 0; i < sizeof(data); i++)
+    {
+        crc ^= (uint16_t) data[i] << 8;
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+/*
+This function will find the newest valid record of the ring and return true with its value if there is any
+
+The sequence numbers of the ring differ by less than the number of slots, so the newest one is found by their difference
+even after the sequence number wraps around.
+*/
+bool eeprom_journal_init(eeprom_journal_t *self, uint32_t address, int slots, twr_tick_t commit_delay, float *value)
+{
+    memset(self, 0, sizeof(*self));
+
+    self->address = address;
+    self->slots = slots;
+    self->commit_delay = commit_delay;
+    self->slot = -1;
+    self->task_id = twr_scheduler_register(eeprom_journal_task, self, TWR_TICK_INFINITY);
+
+    for (int i = 0; i < slots; i++)
+    {
+        eeprom_journal_record_t record;
+
+        if (!twr_eeprom_read(address + i * sizeof(record), &record, sizeof(record)) || record.crc != eeprom_journal_crc(&record))
+        {
+            continue;
+        }
+
+        if (self->slot < 0 || (int16_t) (record.sequence - self->sequence) > 0)
+        {
+            self->slot = i;
+            self->sequence = record.sequence;
+            self->committed = record.value;
+        }
+    }
+
+    if (self->slot < 0)
+    {
+        return false;
+    }
+
+    self->value = self->committed;
+    *value = self->committed;
+
+    return true;
+}
+
+/*
+This function will keep the value and plan its commit after the commit delay, a value equal to the newest record is not written
+*/
+void eeprom_journal_set(eeprom_journal_t *self, float value)
+{
+    self->value = value;
+    self->pending = self->slot < 0 || value != self->committed;
+
+    twr_scheduler_plan_relative(self->task_id, self->pending ? self->commit_delay : TWR_TICK_INFINITY);
+}
+
+/*
+This function will write the pending value to the slot after the newest record right away
+*/
+bool eeprom_journal_commit(eeprom_journal_t *self)
+{
+    if (!self->pending)
+    {
+        return true;
+    }
+
+    eeprom_journal_record_t record = {
+        .sequence = self->slot < 0 ? 0 : self->sequence + 1,
+        .value = self->value
+    };
+    int slot = (self->slot + 1) % self->slots;
+
+    record.crc = eeprom_journal_crc(&record);
+
+    if (!twr_eeprom_write(self->address + slot * sizeof(record), &record, sizeof(record)))
+    {
+        return false;
+    }
+
+    self->slot = slot;
+    self->sequence = record.sequence;
+    self->committed = record.value;
+    self->pending = false;
+    self->commits++;
+
+    twr_log_debug("$EEPROM: journal record %u in slot %d", record.sequence, slot);
+
+    return true;
+}
+
+/*
+Commit task, it runs when the value did not change for the commit delay and tries again after a failed write
+*/
+static void eeprom_journal_task(void *param)
+{
+    eeprom_journal_t *self = param;
+
+    if (!eeprom_journal_commit(self))
+    {
+        twr_scheduler_plan_current_relative(self->commit_delay);
+    }
+}
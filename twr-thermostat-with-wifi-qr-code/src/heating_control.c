@@ -0,0 +1,73 @@
+/*
+Hysteresis control of the heating
+*/
+
+#include <heating_control.h>
+#include <string.h>
+#include <math.h>
+
+void heating_control_init(heating_control_t *self, float hysteresis, twr_tick_t min_on_time, twr_tick_t min_off_time)
+{
+    memset(self, 0, sizeof(*self));
+
+    self->hysteresis = hysteresis;
+    self->min_on_time = min_on_time;
+    self->min_off_time = min_off_time;
+}
+
+/*
+This function will decide the state of the heating from the temperature and the set point and return true when it changed
+
+The first update always returns true, so the state is published after the boot
+*/
+bool heating_control_update(heating_control_t *self, float temperature, float set_point)
+{
+    twr_tick_t now = twr_tick_get();
+    bool heating = self->heating;
+
+    if (isnan(temperature) || isnan(set_point))
+    {
+        heating = false;
+    }
+    else if (temperature < set_point - self->hysteresis / 2)
+    {
+        heating = true;
+    }
+    else if (temperature > set_point + self->hysteresis / 2)
+    {
+        heating = false;
+    }
+
+    if (!self->known)
+    {
+        self->known = true;
+        self->heating = heating;
+        self->changed_tick = now;
+
+        return true;
+    }
+
+    if (heating == self->heating)
+    {
+        return false;
+    }
+
+    // A missing temperature switches the heating off without waiting for the minimum on time
+    if (!isnan(temperature) && now - self->changed_tick < (self->heating ? self->min_on_time : self->min_off_time))
+    {
+        self->held_back++;
+
+        return false;
+    }
+
+    self->heating = heating;
+    self->changed_tick = now;
+    self->switches++;
+
+    return true;
+}
+
+bool heating_control_get_state(const heating_control_t *self)
+{
+    return self->heating;
+}
@@ -0,0 +1,235 @@
+/*
+Line-level update of the memory LCD
+*/
+
+#include <lcd_diff.h>
+#include <string.h>
+
+// Framebuffer of the ls013b7dh03 driver: mode byte, then every line as address byte, 128 pixels in 16 bytes and dummy byte,
+// and a trailing dummy byte
+#define LCD_MODE_WRITE 0x80
+#define LCD_VCOM 0x40
+#define LCD_LINES 128
+#define LCD_LINE_BYTES 16
+#define LCD_LINE_STRIDE 18
+#define LCD_LINE_ADDRESS_OFFSET(y) (1 + (y) * LCD_LINE_STRIDE)
+
+static struct
+{
+    twr_ls013b7dh03_t *lcd;
+
+    // Lines on the display, valid after the first full update and not while they are lent out
+    uint8_t shadow[LCD_LINES][LCD_LINE_BYTES];
+    bool shadow_valid;
+    bool shadow_lent;
+
+    // Changed lines that are not sent yet, and whether a transfer is running
+    uint32_t pending[LCD_LINES / 32];
+    bool busy;
+
+    // Framebuffer bytes replaced by the mode byte and the trailer during the transfer
+    size_t transfer_offset;
+    size_t transfer_length;
+    uint8_t saved_first;
+    uint8_t saved_last;
+
+    lcd_diff_stats_t stats;
+} lcd_diff;
+
+static bool lcd_diff_send_next(void);
+
+/*
+Event handler of the SPI transfer, it puts the borrowed bytes back and sends the next run of changed lines
+*/
+static void lcd_diff_spi_event_handler(twr_spi_event_t event, void *event_param)
+{
+    uint8_t *framebuffer = lcd_diff.lcd->_framebuffer;
+
+    if (event != TWR_SPI_EVENT_DONE)
+    {
+        return;
+    }
+
+    framebuffer[lcd_diff.transfer_offset] = lcd_diff.saved_first;
+    framebuffer[lcd_diff.transfer_offset + lcd_diff.transfer_length - 1] = lcd_diff.saved_last;
+
+    lcd_diff.lcd->_pin_cs_set(0);
+
+    lcd_diff_send_next();
+}
+
+/*
+This function will send the first run of pending lines
+
+The run is sent straight from the framebuffer. The byte in front of its first line address is the dummy byte of the line above
+(or the mode byte), it holds the mode byte during the transfer. The byte behind the dummy byte of its last line is the address
+of the line below (or the trailer), it holds the trailing zero. Both are restored when the transfer is done.
+
+The mode byte carries the VCOM bit of the driver, which is flipped after every transfer like the driver does after its update,
+otherwise the panel would see a DC bias while only changed lines are sent.
+*/
+static bool lcd_diff_send_next(void)
+{
+    int start = 0;
+
+    while (start < LCD_LINES && (lcd_diff.pending[start / 32] & (UINT32_C(1) << (start % 32))) == 0)
+    {
+        start++;
+    }
+
+    if (start == LCD_LINES)
+    {
+        lcd_diff.busy = false;
+
+        return true;
+    }
+
+    int end = start;
+
+    while (end < LCD_LINES && (lcd_diff.pending[end / 32] & (UINT32_C(1) << (end % 32))) != 0)
+    {
+        lcd_diff.pending[end / 32] &= ~(UINT32_C(1) << (end % 32));
+        end++;
+    }
+
+    uint8_t *framebuffer = lcd_diff.lcd->_framebuffer;
+
+    lcd_diff.transfer_offset = LCD_LINE_ADDRESS_OFFSET(start) - 1;
+    lcd_diff.transfer_length = (end - start) * LCD_LINE_STRIDE + 2;
+    lcd_diff.saved_first = framebuffer[lcd_diff.transfer_offset];
+    lcd_diff.saved_last = framebuffer[lcd_diff.transfer_offset + lcd_diff.transfer_length - 1];
+
+    framebuffer[lcd_diff.transfer_offset] = LCD_MODE_WRITE | lcd_diff.lcd->_vcom;
+    framebuffer[lcd_diff.transfer_offset + lcd_diff.transfer_length - 1] = 0;
+
+    lcd_diff.stats.last_transfers++;
+    lcd_diff.busy = true;
+
+    if (lcd_diff.lcd->_pin_cs_set(1))
+    {
+        twr_spi_set_mode(TWR_SPI_MODE_0);
+        twr_spi_set_speed(TWR_SPI_SPEED_1_MHZ);
+
+        if (twr_spi_async_transfer(&framebuffer[lcd_diff.transfer_offset], NULL, lcd_diff.transfer_length, lcd_diff_spi_event_handler, NULL))
+        {
+            lcd_diff.lcd->_vcom ^= LCD_VCOM;
+
+            return true;
+        }
+
+        lcd_diff.lcd->_pin_cs_set(0);
+    }
+
+    // The display does not hold what the shadow says, the next update sends everything
+    framebuffer[lcd_diff.transfer_offset] = lcd_diff.saved_first;
+    framebuffer[lcd_diff.transfer_offset + lcd_diff.transfer_length - 1] = lcd_diff.saved_last;
+    memset(lcd_diff.pending, 0, sizeof(lcd_diff.pending));
+    lcd_diff.shadow_valid = false;
+    lcd_diff.busy = false;
+
+    return false;
+}
+
+/*
+This function will send the lines of the framebuffer that differ from the display, it replaces twr_gfx_update
+
+The first update and the update after an error go through the driver and send the whole framebuffer. Nothing is sent when no
+line changed, the VCOM task of the driver keeps toggling VCOM while the display is idle.
+*/
+bool lcd_diff_update(twr_gfx_t *gfx)
+{
+    lcd_diff.lcd = (twr_ls013b7dh03_t *) gfx->_display;
+
+    if (lcd_diff.busy || !twr_spi_is_ready())
+    {
+        return false;
+    }
+
+    uint8_t *framebuffer = lcd_diff.lcd->_framebuffer;
+    int lines = 0;
+
+    if (!lcd_diff.shadow_valid)
+    {
+        if (!twr_gfx_update(gfx))
+        {
+            return false;
+        }
+
+        if (!lcd_diff.shadow_lent)
+        {
+            for (int y = 0; y < LCD_LINES; y++)
+            {
+                memcpy(lcd_diff.shadow[y], &framebuffer[LCD_LINE_ADDRESS_OFFSET(y) + 1], LCD_LINE_BYTES);
+            }
+
+            lcd_diff.shadow_valid = true;
+        }
+        lcd_diff.stats.last_transfers = 1;
+        lines = LCD_LINES;
+    }
+    else
+    {
+        lcd_diff.stats.last_transfers = 0;
+
+        for (int y = 0; y < LCD_LINES; y++)
+        {
+            uint8_t *line = &framebuffer[LCD_LINE_ADDRESS_OFFSET(y) + 1];
+
+            if (memcmp(lcd_diff.shadow[y], line, LCD_LINE_BYTES) != 0)
+            {
+                memcpy(lcd_diff.shadow[y], line, LCD_LINE_BYTES);
+                lcd_diff.pending[y / 32] |= UINT32_C(1) << (y % 32);
+                lines++;
+            }
+        }
+
+        if (!lcd_diff_send_next())
+        {
+            return false;
+        }
+    }
+
+    lcd_diff.stats.updates++;
+    lcd_diff.stats.lines += lines;
+    lcd_diff.stats.last_lines = lines;
+
+    twr_log_debug("$LCD: %d lines in %d transfers", lines, lcd_diff.stats.last_transfers);
+
+    return true;
+}
+
+/*
+This function will make the next update send the whole framebuffer, for when something else changed the display
+*/
+void lcd_diff_invalidate(void)
+{
+    lcd_diff.shadow_valid = false;
+}
+
+/*
+This function will lend the shadow out as a buffer of 128 lines of 16 bytes, the updates do not use it until it is returned
+
+The runs of lines that are still waiting for their transfer are dropped, the next update sends the whole framebuffer.
+*/
+uint8_t *lcd_diff_lend_shadow(void)
+{
+    memset(lcd_diff.pending, 0, sizeof(lcd_diff.pending));
+    lcd_diff.shadow_valid = false;
+    lcd_diff.shadow_lent = true;
+
+    return &lcd_diff.shadow[0][0];
+}
+
+/*
+This function will take the lent shadow back, the next update sends the whole framebuffer and fills it again
+*/
+void lcd_diff_return_shadow(void)
+{
+    lcd_diff.shadow_valid = false;
+    lcd_diff.shadow_lent = false;
+}
+
+const lcd_diff_stats_t *lcd_diff_get_stats(void)
+{
+    return &lcd_diff.stats;
+}
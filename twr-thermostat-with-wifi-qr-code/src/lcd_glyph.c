@@ -0,0 +1,221 @@
+/*
+Glyph sprites of the few characters of a large font, drawn straight into the LCD framebuffer
+*/
+
+#include <lcd_glyph.h>
+#include <string.h>
+
+// Display line in the LCD framebuffer: address byte, 128 pixels in 16 bytes and dummy byte, behind the mode byte
+#define LCD_LINE_PIXELS 128
+#define LCD_LINES 128
+#define LCD_LINE_OFFSET(y) (2 + (y) * 18)
+
+/*
+This function will tell if the pixel of the framebuffer is black, a white pixel is 1 in the framebuffer
+*/
+static bool lcd_glyph_is_black(const uint8_t *framebuffer, int x, int y)
+{
+    return (framebuffer[LCD_LINE_OFFSET(y) + x / 8] & (0x80 >> (x % 8))) == 0;
+}
+
+static const lcd_glyph_t *lcd_glyph_find(const lcd_glyph_font_t *self, char code)
+{
+    for (size_t i = 0; i < self->count; i++)
+    {
+        if (self->glyphs[i].code == code)
+        {
+            return &self->glyphs[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+This function will rasterise the characters of the charset in the font into sprites stored in data
+
+Every character is drawn by gfx into the top left corner of the cleared framebuffer and read back, so it has to run before anything
+is shown, the framebuffer is cleared again at the end. Characters that are missing in the font, too wide, or do not fit into data are
+skipped, the strings with them are left to the gfx string path. Returns the number of bytes of data used.
+*/
+size_t lcd_glyph_font_init(lcd_glyph_font_t *self, twr_gfx_t *gfx, const twr_font_t *font, const char *charset, uint8_t *data, size_t size)
+{
+    const uint8_t *framebuffer = ((twr_ls013b7dh03_t *) gfx->_display)->_framebuffer;
+    size_t used = 0;
+
+    memset(self, 0, sizeof(*self));
+    self->data = data;
+
+    twr_gfx_set_font(gfx, font);
+
+    for (; *charset != '\0' && self->count < LCD_GLYPH_COUNT_MAX; charset++)
+    {
+        twr_gfx_clear(gfx);
+
+        int width = twr_gfx_draw_char(gfx, 0, 0, (uint8_t) *charset, true);
+        int top = LCD_LINES;
+        int bottom = -1;
+
+        if (width <= 0 || width > LCD_GLYPH_WIDTH_MAX)
+        {
+            continue;
+        }
+
+        for (int y = 0; y < LCD_LINES; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                if (lcd_glyph_is_black(framebuffer, x, y))
+                {
+                    top = top < y ? top : y;
+                    bottom = y;
+                }
+            }
+        }
+
+        int bytes = (width + 7) / 8;
+        int rows = bottom < top ? 0 : bottom - top + 1;
+
+        if (used + (size_t) (rows * bytes) > size)
+        {
+            continue;
+        }
+
+        lcd_glyph_t *glyph = &self->glyphs[self->count++];
+
+        glyph->code = *charset;
+        glyph->width = width;
+        glyph->top = rows > 0 ? top : 0;
+        glyph->rows = rows;
+        glyph->offset = used;
+
+        for (int y = 0; y < rows; y++)
+        {
+            for (int i = 0; i < bytes; i++)
+            {
+                uint8_t byte = 0;
+
+                for (int x = i * 8; x < i * 8 + 8; x++)
+                {
+                    byte <<= 1;
+
+                    if (x < width && lcd_glyph_is_black(framebuffer, x, top + y))
+                    {
+                        byte |= 1;
+                    }
+                }
+
+                data[used++] = byte;
+            }
+        }
+    }
+
+    twr_gfx_clear(gfx);
+
+    return used;
+}
+
+/*
+This function will return the width of the text in pixels, or -1 if a character of the text has no sprite
+*/
+int lcd_glyph_calc_string_width(const lcd_glyph_font_t *self, const char *text)
+{
+    int width = 0;
+
+    for (; *text != '\0'; text++)
+    {
+        const lcd_glyph_t *glyph = lcd_glyph_find(self, *text);
+
+        if (glyph == NULL)
+        {
+            return -1;
+        }
+
+        width += glyph->width;
+    }
+
+    return width;
+}
+
+/*
+This function will draw the black pixels of the text into the framebuffer and return the left edge behind it
+
+The area of the text has to be white already, like after the widget cleared it. Nothing is drawn and -1 is returned when a character
+has no sprite or the text does not fit the display.
+*/
+int lcd_glyph_draw_string(const lcd_glyph_font_t *self, twr_gfx_t *gfx, int left, int top, const char *text)
+{
+    int width = lcd_glyph_calc_string_width(self, text);
+
+    if (width < 0 || left < 0 || left + width > LCD_LINE_PIXELS || top < 0)
+    {
+        return -1;
+    }
+
+    uint8_t *framebuffer = ((twr_ls013b7dh03_t *) gfx->_display)->_framebuffer;
+
+    for (; *text != '\0'; text++)
+    {
+        const lcd_glyph_t *glyph = lcd_glyph_find(self, *text);
+        const uint8_t *sprite = &self->data[glyph->offset];
+        int bytes = (glyph->width + 7) / 8;
+        int shift = left % 8;
+
+        for (int y = top + glyph->top, end = y + glyph->rows; y < end && y < LCD_LINES; y++)
+        {
+            // Up to 24 pixels of the row aligned to the most significant bit, shifted to the pixel in the first framebuffer byte
+            uint32_t bits = 0;
+
+            for (int i = 0; i < bytes; i++)
+            {
+                bits |= (uint32_t) *sprite++ << (24 - 8 * i);
+            }
+
+            bits >>= shift;
+
+            uint8_t *line = &framebuffer[LCD_LINE_OFFSET(y) + left / 8];
+
+            for (int i = 0; bits != 0; i++, bits <<= 8)
+            {
+                line[i] &= ~(uint8_t) (bits >> 24);
+            }
+        }
+
+        left += glyph->width;
+    }
+
+    return left;
+}
+
+/*
+This function will write the value given in tenths as a number with one decimal place, like "-12.5", without the float formatting of printf
+
+The text needs LCD_GLYPH_TENTHS_SIZE bytes.
+*/
+void lcd_glyph_format_tenths(char *text, int32_t tenths)
+{
+    uint32_t value = tenths < 0 ? 0 - (uint32_t) tenths : (uint32_t) tenths;
+    char digits[11];
+    int count = 0;
+
+    do
+    {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    }
+    while (value > 0 || count < 2);
+
+    if (tenths < 0)
+    {
+        *text++ = '-';
+    }
+
+    while (count > 1)
+    {
+        *text++ = digits[--count];
+    }
+
+    *text++ = '.';
+    *text++ = digits[0];
+    *text = '\0';
+}
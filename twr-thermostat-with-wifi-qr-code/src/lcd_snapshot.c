@@ -0,0 +1,158 @@
+/*
+Snapshots of the rendered LCD framebuffer of a page
+*/
+
+#include <lcd_snapshot.h>
+#include <lcd_diff.h>
+#include <string.h>
+
+// Display line in the LCD framebuffer: address byte, 128 pixels in 16 bytes and dummy byte, behind the mode byte
+#define LCD_LINES 128
+#define LCD_LINE_BYTES 16
+#define LCD_LINE_OFFSET(y) (2 + (y) * 18)
+
+// Layout of the snapshot in the EEPROM, change it whenever the header or the lines change
+#define LCD_SNAPSHOT_FORMAT 1
+#define LCD_SNAPSHOT_HEADER_SIZE (2 * sizeof(uint32_t))
+
+/*
+This function will make a snapshot in the given RAM buffer of LCD_SNAPSHOT_SIZE bytes
+*/
+void lcd_snapshot_init_ram(lcd_snapshot_t *self, uint8_t *buffer)
+{
+    memset(self, 0, sizeof(*self));
+
+    self->ram = buffer;
+}
+
+/*
+This function will make a snapshot in the shadow of lcd_diff, the display is sent whole while the snapshot holds it
+*/
+void lcd_snapshot_init_shadow(lcd_snapshot_t *self)
+{
+    memset(self, 0, sizeof(*self));
+
+    self->shadow = true;
+}
+
+/*
+This function will make a snapshot at the given EEPROM address, the snapshot stored there by the last run is valid again
+*/
+void lcd_snapshot_init_eeprom(lcd_snapshot_t *self, uint32_t address)
+{
+    uint32_t header[2];
+
+    memset(self, 0, sizeof(*self));
+
+    self->eeprom_address = address;
+
+    if (address + LCD_SNAPSHOT_EEPROM_SIZE > twr_eeprom_get_size())
+    {
+        return;
+    }
+
+    twr_eeprom_read(address, header, sizeof(header));
+
+    self->tag = header[0];
+    self->valid = header[1] == LCD_SNAPSHOT_FORMAT;
+}
+
+/*
+This function will store the lines of the framebuffer with the tag of what they show
+
+An EEPROM snapshot with the same tag is not written again. Its header is invalidated before the lines are written and written last,
+so a reset in between leaves no valid snapshot with wrong lines.
+*/
+bool lcd_snapshot_save(lcd_snapshot_t *self, twr_gfx_t *gfx, uint32_t tag)
+{
+    const uint8_t *framebuffer = ((twr_ls013b7dh03_t *) gfx->_display)->_framebuffer;
+
+    if (self->shadow && self->ram == NULL)
+    {
+        self->ram = lcd_diff_lend_shadow();
+    }
+
+    if (self->ram != NULL)
+    {
+        for (int y = 0; y < LCD_LINES; y++)
+        {
+            memcpy(&self->ram[y * LCD_LINE_BYTES], &framebuffer[LCD_LINE_OFFSET(y)], LCD_LINE_BYTES);
+        }
+    }
+    else
+    {
+        uint32_t header[2] = { tag, LCD_SNAPSHOT_FORMAT };
+
+        if (self->valid && self->tag == tag)
+        {
+            return true;
+        }
+
+        if (self->eeprom_address + LCD_SNAPSHOT_EEPROM_SIZE > twr_eeprom_get_size())
+        {
+            return false;
+        }
+
+        self->valid = false;
+
+        uint32_t invalid[2] = { 0, 0 };
+
+        if (!twr_eeprom_write(self->eeprom_address, invalid, sizeof(invalid)))
+        {
+            return false;
+        }
+
+        for (int y = 0; y < LCD_LINES; y++)
+        {
+            if (!twr_eeprom_write(self->eeprom_address + LCD_SNAPSHOT_HEADER_SIZE + y * LCD_LINE_BYTES, &framebuffer[LCD_LINE_OFFSET(y)], LCD_LINE_BYTES))
+            {
+                return false;
+            }
+        }
+
+        if (!twr_eeprom_write(self->eeprom_address, header, sizeof(header)))
+        {
+            return false;
+        }
+    }
+
+    self->tag = tag;
+    self->valid = true;
+
+    return true;
+}
+
+/*
+This function will copy the lines of the snapshot back into the framebuffer if the snapshot shows what the tag says
+*/
+bool lcd_snapshot_restore(lcd_snapshot_t *self, twr_gfx_t *gfx, uint32_t tag)
+{
+    uint8_t *framebuffer = ((twr_ls013b7dh03_t *) gfx->_display)->_framebuffer;
+
+    if (!self->valid || self->tag != tag)
+    {
+        return false;
+    }
+
+    for (int y = 0; y < LCD_LINES; y++)
+    {
+        if (self->ram != NULL)
+        {
+            memcpy(&framebuffer[LCD_LINE_OFFSET(y)], &self->ram[y * LCD_LINE_BYTES], LCD_LINE_BYTES);
+        }
+        else
+        {
+            twr_eeprom_read(self->eeprom_address + LCD_SNAPSHOT_HEADER_SIZE + y * LCD_LINE_BYTES, &framebuffer[LCD_LINE_OFFSET(y)], LCD_LINE_BYTES);
+        }
+    }
+
+    if (self->shadow)
+    {
+        self->ram = NULL;
+        self->valid = false;
+
+        lcd_diff_return_shadow();
+    }
+
+    return true;
+}
@@ -0,0 +1,227 @@
+/*
+Text widgets of an LCD page that remember what is on the screen
+*/
+
+#include <lcd_widget.h>
+#include <lcd_diff.h>
+#include <string.h>
+
+// Tag of the snapshot of a page, it always shows the widgets of the page as they were drawn
+#define LCD_WIDGET_SNAPSHOT_TAG 1
+
+static void lcd_widget_page_task(void *param);
+
+/*
+This function will register the redraw task of the page, the page is hidden until lcd_widget_page_show is called
+*/
+void lcd_widget_page_init(lcd_widget_page_t *self, twr_gfx_t *gfx, lcd_widget_t *widgets, size_t count)
+{
+    memset(self, 0, sizeof(*self));
+
+    self->gfx = gfx;
+    self->widgets = widgets;
+    self->count = count;
+    self->task_id = twr_scheduler_register(lcd_widget_page_task, self, TWR_TICK_INFINITY);
+}
+
+/*
+This function will let the page keep its rendered framebuffer in the snapshot while it is hidden
+*/
+void lcd_widget_page_set_snapshot(lcd_widget_page_t *self, lcd_snapshot_t *snapshot)
+{
+    self->snapshot = snapshot;
+}
+
+/*
+This function will plan the redraw of the page one frame later unless it is already planned
+*/
+static void lcd_widget_page_plan_redraw(lcd_widget_page_t *self)
+{
+    if (self->shown && !self->redraw_planned)
+    {
+        self->redraw_planned = true;
+
+        twr_scheduler_plan_relative(self->task_id, LCD_WIDGET_FRAME_TIME);
+    }
+}
+
+/*
+This function will show the page on the whole screen
+
+The screen holds something else until then, so the redraw right away restores the snapshot of the page, or clears the screen and
+draws all the widgets again when there is no snapshot
+*/
+void lcd_widget_page_show(lcd_widget_page_t *self)
+{
+    if (self->shown)
+    {
+        return;
+    }
+
+    self->shown = true;
+    self->clear = true;
+    self->redraw_planned = true;
+
+    twr_scheduler_plan_now(self->task_id);
+}
+
+/*
+This function will stop drawing the page, the widgets still take the new texts
+
+The framebuffer still holds the page, it goes to the snapshot. The widgets that changed and were not drawn yet stay dirty, and the
+area they were drawn to matches the snapshot.
+*/
+void lcd_widget_page_hide(lcd_widget_page_t *self)
+{
+    if (self->shown && !self->clear && self->snapshot != NULL)
+    {
+        lcd_snapshot_save(self->snapshot, self->gfx, LCD_WIDGET_SNAPSHOT_TAG);
+    }
+
+    self->shown = false;
+}
+
+/*
+This function will change the text of the widget, the page is redrawn only when the text is different from the current one
+*/
+void lcd_widget_set_text(lcd_widget_page_t *self, lcd_widget_t *widget, const char *text)
+{
+    char new_text[LCD_WIDGET_TEXT_SIZE];
+
+    strncpy(new_text, text, sizeof(new_text) - 1);
+    new_text[sizeof(new_text) - 1] = '\0';
+
+    if (strcmp(widget->text, new_text) == 0)
+    {
+        return;
+    }
+
+    strcpy(widget->text, new_text);
+    widget->dirty = true;
+
+    lcd_widget_page_plan_redraw(self);
+}
+
+/*
+Redraw task of the page
+
+Showing the page restores the snapshot, then only the widgets that changed while the page was hidden are drawn. The widgets are laid out first, so that a widget is also redrawn when its anchor changed width. Then the old areas of all the dirty
+widgets are cleared before any of them is drawn, so a widget never erases a neighbour that was just drawn.
+*/
+static void lcd_widget_page_task(void *param)
+{
+    lcd_widget_page_t *self = param;
+
+    if (!self->shown)
+    {
+        self->redraw_planned = false;
+
+        return;
+    }
+
+    if (!twr_module_lcd_is_ready())
+    {
+        twr_scheduler_plan_current_relative(LCD_WIDGET_FRAME_TIME);
+
+        return;
+    }
+
+    self->redraw_planned = false;
+
+    twr_system_pll_enable();
+
+    if (self->clear)
+    {
+        if (self->snapshot == NULL || !lcd_snapshot_restore(self->snapshot, self->gfx, LCD_WIDGET_SNAPSHOT_TAG))
+        {
+            twr_gfx_clear(self->gfx);
+
+            for (size_t i = 0; i < self->count; i++)
+            {
+                self->widgets[i].dirty = true;
+                self->widgets[i].drawn_width = 0;
+            }
+        }
+
+        self->clear = false;
+        self->refresh = true;
+    }
+
+    bool changed = self->refresh;
+
+    for (size_t i = 0; i < self->count; i++)
+    {
+        lcd_widget_t *widget = &self->widgets[i];
+
+        widget->next_left = widget->left;
+
+        if (widget->anchor != NULL)
+        {
+            widget->next_left = widget->anchor->next_left + widget->anchor->next_width + widget->gap;
+        }
+
+        if (widget->next_left != widget->drawn_left)
+        {
+            widget->dirty = true;
+        }
+
+        if (widget->dirty)
+        {
+            widget->next_width = widget->glyphs != NULL ? lcd_glyph_calc_string_width(widget->glyphs, widget->text) : -1;
+
+            if (widget->next_width < 0)
+            {
+                twr_gfx_set_font(self->gfx, widget->font);
+                widget->next_width = twr_gfx_calc_string_width(self->gfx, widget->text);
+            }
+        }
+        else
+        {
+            widget->next_width = widget->drawn_width;
+        }
+    }
+
+    for (size_t i = 0; i < self->count; i++)
+    {
+        lcd_widget_t *widget = &self->widgets[i];
+
+        if (widget->dirty && widget->drawn_width > 0)
+        {
+            twr_gfx_draw_fill_rectangle(self->gfx, widget->drawn_left, widget->top, widget->drawn_left + widget->drawn_width - 1, widget->top + widget->height - 1, false);
+        }
+    }
+
+    for (size_t i = 0; i < self->count; i++)
+    {
+        lcd_widget_t *widget = &self->widgets[i];
+
+        if (widget->dirty)
+        {
+            if (widget->glyphs == NULL || lcd_glyph_draw_string(widget->glyphs, self->gfx, widget->next_left, widget->top, widget->text) < 0)
+            {
+                twr_gfx_set_font(self->gfx, widget->font);
+                twr_gfx_draw_string(self->gfx, widget->next_left, widget->top, widget->text, true);
+            }
+
+            widget->drawn_left = widget->next_left;
+            widget->drawn_width = widget->next_width;
+            widget->dirty = false;
+            changed = true;
+        }
+    }
+
+    if (changed)
+    {
+        // The lines that were not sent still differ from what lcd_diff has sent, so a later update sends them
+        self->refresh = !lcd_diff_update(self->gfx);
+
+        if (self->refresh)
+        {
+            self->redraw_planned = true;
+
+            twr_scheduler_plan_current_relative(LCD_WIDGET_FRAME_TIME);
+        }
+    }
+
+    twr_system_pll_disable();
+}
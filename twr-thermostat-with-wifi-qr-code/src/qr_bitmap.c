@@ -0,0 +1,335 @@
+/*
+Compressed bitmap of a QR code symbol, shared by the thermostat and the gateway encoder
+*/
+
+#include <qr_bitmap.h>
+#include <qrcodegen.h>
+#include <string.h>
+
+// Runs of at least this many equal bytes are stored as a PackBits run
+#define RUN_LENGTH_MIN 3
+#define PACKET_LENGTH_MAX 128
+
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*
+This function will return one byte of the packed modules, modules past the end of the symbol are 0
+*/
+static uint8_t packed_byte(const uint8_t qrcode[], int size, size_t index)
+{
+    uint8_t byte = 0;
+
+    for (int i = 0; i < 8; i++)
+    {
+        size_t module = index * 8 + i;
+
+        byte <<= 1;
+
+        if (module < (size_t) (size * size) && qrcodegen_getModule(qrcode, module % size, module / size))
+        {
+            byte |= 1;
+        }
+    }
+
+    return byte;
+}
+
+/*
+This function will compress the packed modules with PackBits behind the stream header
+
+Returns the length of the stream or 0 if it is not shorter than limit
+*/
+static size_t encode_packbits(const uint8_t qrcode[], int size, uint8_t *stream, size_t limit)
+{
+    size_t packed_length = ((size_t) size * size + 7) / 8;
+    size_t length = 2;
+    size_t i = 0;
+
+    while (i < packed_length)
+    {
+        uint8_t byte = packed_byte(qrcode, size, i);
+        size_t run = 1;
+
+        while (i + run < packed_length && run < PACKET_LENGTH_MAX && packed_byte(qrcode, size, i + run) == byte)
+        {
+            run++;
+        }
+
+        if (run >= RUN_LENGTH_MIN)
+        {
+            if (length + 2 >= limit)
+            {
+                return 0;
+            }
+
+            stream[length++] = 257 - run;
+            stream[length++] = byte;
+            i += run;
+
+            continue;
+        }
+
+        // Literal packet up to the next run or the longest packet
+        size_t count = 0;
+        size_t header = length++;
+
+        while (i < packed_length && count < PACKET_LENGTH_MAX)
+        {
+            byte = packed_byte(qrcode, size, i);
+
+            if (i + 2 < packed_length && packed_byte(qrcode, size, i + 1) == byte && packed_byte(qrcode, size, i + 2) == byte)
+            {
+                break;
+            }
+
+            if (length + 1 >= limit)
+            {
+                return 0;
+            }
+
+            stream[length++] = byte;
+            count++;
+            i++;
+        }
+
+        stream[header] = count - 1;
+    }
+
+    return length;
+}
+
+/*
+This function will write the QR code symbol into the stream, compressed if it helps
+
+Returns the length of the stream or 0 if it does not fit the stream buffer
+*/
+size_t qr_bitmap_encode(const uint8_t qrcode[], uint8_t *stream, size_t stream_size)
+{
+    int size = qrcodegen_getSize(qrcode);
+    size_t packed_length = ((size_t) size * size + 7) / 8;
+    size_t stored_length = 2 + packed_length;
+    size_t length;
+
+    if (stream_size < 2)
+    {
+        return 0;
+    }
+
+    stream[1] = size;
+
+    length = encode_packbits(qrcode, size, stream, stored_length < stream_size ? stored_length : stream_size);
+
+    if (length != 0)
+    {
+        stream[0] = QR_BITMAP_FORMAT_PACKBITS;
+
+        return length;
+    }
+
+    if (stored_length > stream_size)
+    {
+        return 0;
+    }
+
+    stream[0] = QR_BITMAP_FORMAT_STORED;
+
+    for (size_t i = 0; i < packed_length; i++)
+    {
+        stream[2 + i] = packed_byte(qrcode, size, i);
+    }
+
+    return stored_length;
+}
+
+/*
+This function will set the eight modules of the next packed byte, it returns false if the byte is past the end of the symbol
+*/
+static bool decode_byte(uint8_t qrcode[], int size, size_t *module, uint8_t byte)
+{
+    size_t module_count = (size_t) size * size;
+
+    if (*module >= module_count)
+    {
+        return false;
+    }
+
+    for (int bit = 7; bit >= 0; bit--, (*module)++)
+    {
+        if (((byte >> bit) & 1) == 0)
+        {
+            continue;
+        }
+
+        // Padding after the last module must be white
+        if (*module >= module_count)
+        {
+            return false;
+        }
+
+        qrcodegen_setModule(qrcode, *module % size, *module / size, true);
+    }
+
+    return true;
+}
+
+/*
+This function will decompress the stream into the QR code symbol
+
+The qrcode buffer must be qrcodegen_BUFFER_LEN_FOR_VERSION(version_max) bytes long and aligned to 4 bytes.
+Returns false if the stream is damaged, has another format or the symbol is bigger than version_max.
+*/
+bool qr_bitmap_decode(const uint8_t *stream, size_t length, uint8_t qrcode[], int version_max)
+{
+    if (length < 2 || (stream[0] != QR_BITMAP_FORMAT_STORED && stream[0] != QR_BITMAP_FORMAT_PACKBITS))
+    {
+        return false;
+    }
+
+    int size = stream[1];
+
+    if (size < qrcodegen_VERSION_MIN * 4 + 17 || size > version_max * 4 + 17 || (size - 17) % 4 != 0)
+    {
+        return false;
+    }
+
+    size_t module = 0;
+    size_t i = 2;
+
+    qrcodegen_initSymbol(qrcode, size);
+
+    while (i < length)
+    {
+        if (stream[0] == QR_BITMAP_FORMAT_STORED)
+        {
+            if (!decode_byte(qrcode, size, &module, stream[i++]))
+            {
+                return false;
+            }
+
+            continue;
+        }
+
+        uint8_t header = stream[i++];
+        bool run = header > 128;
+        size_t count = run ? 257u - header : header + 1u;
+
+        if (header == 128)
+        {
+            continue;
+        }
+
+        if (i + (run ? 1 : count) > length)
+        {
+            return false;
+        }
+
+        for (size_t j = 0; j < count; j++)
+        {
+            if (!decode_byte(qrcode, size, &module, run ? stream[i] : stream[i + j]))
+            {
+                return false;
+            }
+        }
+
+        i += run ? 1 : count;
+    }
+
+    return module >= (size_t) size * size;
+}
+
+/*
+This function will write the data as base64 text with padding and a terminating NUL
+
+Returns the length of the text or 0 if it does not fit the text buffer
+*/
+size_t qr_bitmap_base64_encode(const uint8_t *data, size_t length, char *text, size_t text_size)
+{
+    size_t text_length = QR_BITMAP_BASE64_LEN(length);
+
+    if (text_length + 1 > text_size)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0, j = 0; i < length; i += 3, j += 4)
+    {
+        uint32_t group = (uint32_t) data[i] << 16;
+
+        if (i + 1 < length)
+        {
+            group |= (uint32_t) data[i + 1] << 8;
+        }
+
+        if (i + 2 < length)
+        {
+            group |= data[i + 2];
+        }
+
+        text[j] = base64_alphabet[(group >> 18) & 0x3f];
+        text[j + 1] = base64_alphabet[(group >> 12) & 0x3f];
+        text[j + 2] = i + 1 < length ? base64_alphabet[(group >> 6) & 0x3f] : '=';
+        text[j + 3] = i + 2 < length ? base64_alphabet[group & 0x3f] : '=';
+    }
+
+    text[text_length] = '\0';
+
+    return text_length;
+}
+
+/*
+This function will decode the base64 text with padding, the data may be stored over the text itself
+
+Returns false if the text is not valid base64
+*/
+bool qr_bitmap_base64_decode(const char *text, size_t length, uint8_t *data, size_t *data_length)
+{
+    size_t j = 0;
+
+    if (length % 4 != 0)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < length; i += 4)
+    {
+        uint32_t group = 0;
+        int padding = 0;
+
+        for (int k = 0; k < 4; k++)
+        {
+            char c = text[i + k];
+            const char *position = c != '\0' ? strchr(base64_alphabet, c) : NULL;
+
+            // Padding is allowed only at the end of the last group
+            if (c == '=' && i + 4 == length && k >= 2 && (k == 3 || text[i + 3] == '='))
+            {
+                padding++;
+                group <<= 6;
+            }
+            else if (position != NULL && padding == 0)
+            {
+                group = (group << 6) | (uint32_t) (position - base64_alphabet);
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        data[j++] = group >> 16;
+
+        if (padding < 2)
+        {
+            data[j++] = group >> 8;
+        }
+
+        if (padding < 1)
+        {
+            data[j++] = group;
+        }
+    }
+
+    *data_length = j;
+
+    return true;
+}
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "qrcodegen.h"
+#include "qrcodegen_templates.h"
 
 #ifndef QRCODEGEN_TEST
 	#define testable static  // Keep functions private
@@ -39,6 +40,23 @@
 	#endif
 #endif
 
+// Keeps the frame of a function out of its caller, so that it is not on the stack during the
+// rest of the caller. Used on the mode search, which would otherwise stay under drawSymbol().
+#if defined(__GNUC__)
+	#define NOINLINE  __attribute__((noinline))
+#else
+	#define NOINLINE
+#endif
+
+// Selects how Reed-Solomon error correction codes are computed, trading flash for speed:
+// - 0: Bitwise multiplication in GF(2^8/0x11D), no tables.
+// - 1: Log/antilog tables of the field (768 bytes of flash).
+// - 2: Same as 1, plus constant generator polynomials for all degrees
+//      used by the QR Code standard (another 277 bytes of flash).
+#ifndef QRCODEGEN_RS_TABLES
+	#define QRCODEGEN_RS_TABLES  2
+#endif
+
 
 /*---- Forward declarations for private functions ----*/
 
@@ -60,6 +78,13 @@
 
 testable void appendBitsToBuffer(unsigned int val, int numBits, uint8_t buffer[], int *bitLen);
 
+static void appendNumericBits(const char *digits, size_t len, uint8_t buf[], int *bitLen);
+static void appendAlphanumericBits(const char *text, size_t len, uint8_t buf[], int *bitLen);
+static void appendSegmentBits(enum qrcodegen_Mode mode, const char *text, size_t len, int version, uint8_t buf[], int *bitLen);
+NOINLINE static long getOptimalModes(const char *text, size_t len, int version, uint8_t modes[]);
+static bool fitsCharCountFields(const uint8_t modes[], size_t len, int version);
+static void drawSymbol(uint8_t qrcode[], int bitLen, int version, enum qrcodegen_Ecc ecl, int mask, uint8_t tempBuffer[]);
+
 testable void appendErrorCorrection(uint8_t data[], int version, enum qrcodegen_Ecc ecl, uint8_t result[]);
 testable int getNumDataCodewords(int version, enum qrcodegen_Ecc ecl);
 testable int getNumRawDataModules(int version);
@@ -74,14 +99,23 @@ static void drawWhiteFunctionModules(uint8_t qrcode[], int version);
 static void drawFormatBits(enum qrcodegen_Ecc ecl, enum qrcodegen_Mask mask, uint8_t qrcode[]);
 testable int getAlignmentPatternPositions(int version, uint8_t result[7]);
 static void fillRectangle(int left, int top, int width, int height, uint8_t qrcode[]);
+static void copyTemplate(const uint32_t plane[], int version, uint8_t qrcode[]);
 
 static void drawCodewords(const uint8_t data[], int dataLen, uint8_t qrcode[]);
 static void applyMask(const uint8_t functionModules[], uint8_t qrcode[], enum qrcodegen_Mask mask);
-static long getPenaltyScore(const uint8_t qrcode[]);
+static long getPenaltyScore(const uint8_t qrcode[], long limit, bool rowsOnly);
+static long getRunPenalty(int length);
+static void shiftRow(const uint32_t row[], int rowWords, int k, uint32_t result[]);
+static void setLowBits(int count, int rowWords, uint32_t result[]);
+static int countBits(uint32_t x);
 
 testable bool getModule(const uint8_t qrcode[], int x, int y);
 testable void setModule(uint8_t qrcode[], int x, int y, bool isBlack);
 testable void setModuleBounded(uint8_t qrcode[], int x, int y, bool isBlack);
+static int getRowWords(int qrsize);
+static uint32_t getRowWord(const uint8_t qrcode[], int i);
+static void setRowWord(uint8_t qrcode[], int i, uint32_t word);
+static void getRow(const uint8_t qrcode[], int y, int rowWords, uint32_t result[]);
 static bool getBit(int x, int i);
 
 testable int calcSegmentBitLength(enum qrcodegen_Mode mode, size_t numChars);
@@ -95,6 +129,11 @@ static int numCharCountBits(enum qrcodegen_Mode mode, int version);
 // For checking text and encoding segments.
 static const char *ALPHANUMERIC_CHARSET = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:";
 
+// The modes that qrcodegen_encodeTextOptimal() chooses between, indexed by getOptimalModes().
+static const enum qrcodegen_Mode OPTIMAL_MODES[3] = {
+	qrcodegen_Mode_NUMERIC, qrcodegen_Mode_ALPHANUMERIC, qrcodegen_Mode_BYTE,
+};
+
 // For generating error correction codes.
 testable const int8_t ECC_CODEWORDS_PER_BLOCK[4][41] = {
 	// Version: (note that index 0 is for padding, and is set to an illegal value)
@@ -121,6 +160,242 @@ static const int PENALTY_N2 = 3;
 static const int PENALTY_N3 = 40;
 static const int PENALTY_N4 = 10;
 
+// Number of words in the longest row, for the row buffers of the penalty scoring.
+#define MAX_ROW_WORDS  ((qrcodegen_VERSION_MAX * 4 + 17 + 31) / 32)
+
+// The rows of modules are copied in and out of the byte buffer with memcpy, which GCC turns
+// into single word loads and stores once it knows that the word is aligned to 4 bytes.
+#if defined(__GNUC__)
+	#define ALIGNED_WORD(p)  __builtin_assume_aligned((p), 4)
+#else
+	#define ALIGNED_WORD(p)  (p)
+#endif
+
+// For applying mask patterns 32 modules at a time. Bit b of word w in row r of mask m
+// is set iff the module (x = 32 * w + b, y = r) is inverted by mask m. The patterns repeat
+// every 12 rows and every 96 columns, so any row y uses MASK_PATTERNS[m][y % 12][w % 3].
+static const uint32_t MASK_PATTERNS[8][12][3] = {
+	{  // Mask 0
+		{0x55555555U, 0x55555555U, 0x55555555U},
+		{0xAAAAAAAAU, 0xAAAAAAAAU, 0xAAAAAAAAU},
+		{0x55555555U, 0x55555555U, 0x55555555U},
+		{0xAAAAAAAAU, 0xAAAAAAAAU, 0xAAAAAAAAU},
+		{0x55555555U, 0x55555555U, 0x55555555U},
+		{0xAAAAAAAAU, 0xAAAAAAAAU, 0xAAAAAAAAU},
+		{0x55555555U, 0x55555555U, 0x55555555U},
+		{0xAAAAAAAAU, 0xAAAAAAAAU, 0xAAAAAAAAU},
+		{0x55555555U, 0x55555555U, 0x55555555U},
+		{0xAAAAAAAAU, 0xAAAAAAAAU, 0xAAAAAAAAU},
+		{0x55555555U, 0x55555555U, 0x55555555U},
+		{0xAAAAAAAAU, 0xAAAAAAAAU, 0xAAAAAAAAU},
+	},
+	{  // Mask 1
+		{0xFFFFFFFFU, 0xFFFFFFFFU, 0xFFFFFFFFU},
+		{0x00000000U, 0x00000000U, 0x00000000U},
+		{0xFFFFFFFFU, 0xFFFFFFFFU, 0xFFFFFFFFU},
+		{0x00000000U, 0x00000000U, 0x00000000U},
+		{0xFFFFFFFFU, 0xFFFFFFFFU, 0xFFFFFFFFU},
+		{0x00000000U, 0x00000000U, 0x00000000U},
+		{0xFFFFFFFFU, 0xFFFFFFFFU, 0xFFFFFFFFU},
+		{0x00000000U, 0x00000000U, 0x00000000U},
+		{0xFFFFFFFFU, 0xFFFFFFFFU, 0xFFFFFFFFU},
+		{0x00000000U, 0x00000000U, 0x00000000U},
+		{0xFFFFFFFFU, 0xFFFFFFFFU, 0xFFFFFFFFU},
+		{0x00000000U, 0x00000000U, 0x00000000U},
+	},
+	{  // Mask 2
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+	},
+	{  // Mask 3
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x24924924U, 0x49249249U, 0x92492492U},
+		{0x92492492U, 0x24924924U, 0x49249249U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x24924924U, 0x49249249U, 0x92492492U},
+		{0x92492492U, 0x24924924U, 0x49249249U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x24924924U, 0x49249249U, 0x92492492U},
+		{0x92492492U, 0x24924924U, 0x49249249U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x24924924U, 0x49249249U, 0x92492492U},
+		{0x92492492U, 0x24924924U, 0x49249249U},
+	},
+	{  // Mask 4
+		{0xC71C71C7U, 0x71C71C71U, 0x1C71C71CU},
+		{0xC71C71C7U, 0x71C71C71U, 0x1C71C71CU},
+		{0x38E38E38U, 0x8E38E38EU, 0xE38E38E3U},
+		{0x38E38E38U, 0x8E38E38EU, 0xE38E38E3U},
+		{0xC71C71C7U, 0x71C71C71U, 0x1C71C71CU},
+		{0xC71C71C7U, 0x71C71C71U, 0x1C71C71CU},
+		{0x38E38E38U, 0x8E38E38EU, 0xE38E38E3U},
+		{0x38E38E38U, 0x8E38E38EU, 0xE38E38E3U},
+		{0xC71C71C7U, 0x71C71C71U, 0x1C71C71CU},
+		{0xC71C71C7U, 0x71C71C71U, 0x1C71C71CU},
+		{0x38E38E38U, 0x8E38E38EU, 0xE38E38E3U},
+		{0x38E38E38U, 0x8E38E38EU, 0xE38E38E3U},
+	},
+	{  // Mask 5
+		{0xFFFFFFFFU, 0xFFFFFFFFU, 0xFFFFFFFFU},
+		{0x41041041U, 0x10410410U, 0x04104104U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x55555555U, 0x55555555U, 0x55555555U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x41041041U, 0x10410410U, 0x04104104U},
+		{0xFFFFFFFFU, 0xFFFFFFFFU, 0xFFFFFFFFU},
+		{0x41041041U, 0x10410410U, 0x04104104U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x55555555U, 0x55555555U, 0x55555555U},
+		{0x49249249U, 0x92492492U, 0x24924924U},
+		{0x41041041U, 0x10410410U, 0x04104104U},
+	},
+	{  // Mask 6
+		{0xFFFFFFFFU, 0xFFFFFFFFU, 0xFFFFFFFFU},
+		{0xC71C71C7U, 0x71C71C71U, 0x1C71C71CU},
+		{0xDB6DB6DBU, 0xB6DB6DB6U, 0x6DB6DB6DU},
+		{0x55555555U, 0x55555555U, 0x55555555U},
+		{0x6DB6DB6DU, 0xDB6DB6DBU, 0xB6DB6DB6U},
+		{0x71C71C71U, 0x1C71C71CU, 0xC71C71C7U},
+		{0xFFFFFFFFU, 0xFFFFFFFFU, 0xFFFFFFFFU},
+		{0xC71C71C7U, 0x71C71C71U, 0x1C71C71CU},
+		{0xDB6DB6DBU, 0xB6DB6DB6U, 0x6DB6DB6DU},
+		{0x55555555U, 0x55555555U, 0x55555555U},
+		{0x6DB6DB6DU, 0xDB6DB6DBU, 0xB6DB6DB6U},
+		{0x71C71C71U, 0x1C71C71CU, 0xC71C71C7U},
+	},
+	{  // Mask 7
+		{0x55555555U, 0x55555555U, 0x55555555U},
+		{0x38E38E38U, 0x8E38E38EU, 0xE38E38E3U},
+		{0x71C71C71U, 0x1C71C71CU, 0xC71C71C7U},
+		{0xAAAAAAAAU, 0xAAAAAAAAU, 0xAAAAAAAAU},
+		{0xC71C71C7U, 0x71C71C71U, 0x1C71C71CU},
+		{0x8E38E38EU, 0xE38E38E3U, 0x38E38E38U},
+		{0x55555555U, 0x55555555U, 0x55555555U},
+		{0x38E38E38U, 0x8E38E38EU, 0xE38E38E3U},
+		{0x71C71C71U, 0x1C71C71CU, 0xC71C71C7U},
+		{0xAAAAAAAAU, 0xAAAAAAAAU, 0xAAAAAAAAU},
+		{0xC71C71C7U, 0x71C71C71U, 0x1C71C71CU},
+		{0x8E38E38EU, 0xE38E38E3U, 0x38E38E38U},
+	},
+};
+
+#if QRCODEGEN_RS_TABLES >= 1
+// Antilogarithms of GF(2^8/0x11D) to the base 0x02, for generating error correction codes.
+// The table is repeated twice so that the sum of two logarithms can index it without a modulo.
+static const uint8_t RS_EXP[512] = {
+	0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26,
+	0x4C, 0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0,
+	0x9D, 0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23,
+	0x46, 0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1,
+	0x5F, 0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0,
+	0xFD, 0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2,
+	0xD9, 0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE,
+	0x81, 0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC,
+	0x85, 0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54,
+	0xA8, 0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73,
+	0xE6, 0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF,
+	0xE3, 0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41,
+	0x82, 0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6,
+	0x51, 0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09,
+	0x12, 0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16,
+	0x2C, 0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E, 0x01,
+	0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26, 0x4C,
+	0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0, 0x9D,
+	0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23, 0x46,
+	0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1, 0x5F,
+	0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0, 0xFD,
+	0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2, 0xD9,
+	0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE, 0x81,
+	0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC, 0x85,
+	0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54, 0xA8,
+	0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73, 0xE6,
+	0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF, 0xE3,
+	0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41, 0x82,
+	0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6, 0x51,
+	0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09, 0x12,
+	0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16, 0x2C,
+	0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E, 0x01, 0x02,
+};
+
+// Logarithms of GF(2^8/0x11D) to the base 0x02 (index 0 is not a valid input).
+static const uint8_t RS_LOG[256] = {
+	0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1A, 0xC6, 0x03, 0xDF, 0x33, 0xEE, 0x1B, 0x68, 0xC7, 0x4B,
+	0x04, 0x64, 0xE0, 0x0E, 0x34, 0x8D, 0xEF, 0x81, 0x1C, 0xC1, 0x69, 0xF8, 0xC8, 0x08, 0x4C, 0x71,
+	0x05, 0x8A, 0x65, 0x2F, 0xE1, 0x24, 0x0F, 0x21, 0x35, 0x93, 0x8E, 0xDA, 0xF0, 0x12, 0x82, 0x45,
+	0x1D, 0xB5, 0xC2, 0x7D, 0x6A, 0x27, 0xF9, 0xB9, 0xC9, 0x9A, 0x09, 0x78, 0x4D, 0xE4, 0x72, 0xA6,
+	0x06, 0xBF, 0x8B, 0x62, 0x66, 0xDD, 0x30, 0xFD, 0xE2, 0x98, 0x25, 0xB3, 0x10, 0x91, 0x22, 0x88,
+	0x36, 0xD0, 0x94, 0xCE, 0x8F, 0x96, 0xDB, 0xBD, 0xF1, 0xD2, 0x13, 0x5C, 0x83, 0x38, 0x46, 0x40,
+	0x1E, 0x42, 0xB6, 0xA3, 0xC3, 0x48, 0x7E, 0x6E, 0x6B, 0x3A, 0x28, 0x54, 0xFA, 0x85, 0xBA, 0x3D,
+	0xCA, 0x5E, 0x9B, 0x9F, 0x0A, 0x15, 0x79, 0x2B, 0x4E, 0xD4, 0xE5, 0xAC, 0x73, 0xF3, 0xA7, 0x57,
+	0x07, 0x70, 0xC0, 0xF7, 0x8C, 0x80, 0x63, 0x0D, 0x67, 0x4A, 0xDE, 0xED, 0x31, 0xC5, 0xFE, 0x18,
+	0xE3, 0xA5, 0x99, 0x77, 0x26, 0xB8, 0xB4, 0x7C, 0x11, 0x44, 0x92, 0xD9, 0x23, 0x20, 0x89, 0x2E,
+	0x37, 0x3F, 0xD1, 0x5B, 0x95, 0xBC, 0xCF, 0xCD, 0x90, 0x87, 0x97, 0xB2, 0xDC, 0xFC, 0xBE, 0x61,
+	0xF2, 0x56, 0xD3, 0xAB, 0x14, 0x2A, 0x5D, 0x9E, 0x84, 0x3C, 0x39, 0x53, 0x47, 0x6D, 0x41, 0xA2,
+	0x1F, 0x2D, 0x43, 0xD8, 0xB7, 0x7B, 0xA4, 0x76, 0xC4, 0x17, 0x49, 0xEC, 0x7F, 0x0C, 0x6F, 0xF6,
+	0x6C, 0xA1, 0x3B, 0x52, 0x29, 0x9D, 0x55, 0xAA, 0xFB, 0x60, 0x86, 0xB1, 0xBB, 0xCC, 0x3E, 0x5A,
+	0xCB, 0x59, 0x5F, 0xB0, 0x9C, 0xA9, 0xA0, 0x51, 0x0B, 0xF5, 0x16, 0xEB, 0x7A, 0x75, 0x2C, 0xD7,
+	0x4F, 0xAE, 0xD5, 0xE9, 0xE6, 0xE7, 0xAD, 0xE8, 0x74, 0xD6, 0xF4, 0xEA, 0xA8, 0x50, 0x58, 0xAF,
+};
+#endif
+
+#if QRCODEGEN_RS_TABLES >= 2
+// Reed-Solomon generator polynomials for every degree used in ECC_CODEWORDS_PER_BLOCK,
+// in the same format as calcReedSolomonGenerator() produces them, concatenated.
+static const uint8_t RS_GENERATORS[246] = {
+	// Degree 7
+	0x7F, 0x7A, 0x9A, 0xA4, 0x0B, 0x44, 0x75,
+	// Degree 10
+	0xD8, 0xC2, 0x9F, 0x6F, 0xC7, 0x5E, 0x5F, 0x71, 0x9D, 0xC1,
+	// Degree 13
+	0x89, 0x49, 0xE3, 0x11, 0xB1, 0x11, 0x34, 0x0D, 0x2E, 0x2B, 0x53, 0x84, 0x78,
+	// Degree 15
+	0x1D, 0xC4, 0x6F, 0xA3, 0x70, 0x4A, 0x0A, 0x69, 0x69, 0x8B, 0x84, 0x97, 0x20, 0x86, 0x1A,
+	// Degree 16
+	0x3B, 0x0D, 0x68, 0xBD, 0x44, 0xD1, 0x1E, 0x08, 0xA3, 0x41, 0x29, 0xE5, 0x62, 0x32, 0x24,
+	0x3B,
+	// Degree 17
+	0x77, 0x42, 0x53, 0x78, 0x77, 0x16, 0xC5, 0x53, 0xF9, 0x29, 0x8F, 0x86, 0x55, 0x35, 0x7D,
+	0x63, 0x4F,
+	// Degree 18
+	0xEF, 0xFB, 0xB7, 0x71, 0x95, 0xAF, 0xC7, 0xD7, 0xF0, 0xDC, 0x49, 0x52, 0xAD, 0x4B, 0x20,
+	0x43, 0xD9, 0x92,
+	// Degree 20
+	0x98, 0xB9, 0xF0, 0x05, 0x6F, 0x63, 0x06, 0xDC, 0x70, 0x96, 0x45, 0x24, 0xBB, 0x16, 0xE4,
+	0xC6, 0x79, 0x79, 0xA5, 0xAE,
+	// Degree 22
+	0x59, 0xB3, 0x83, 0xB0, 0xB6, 0xF4, 0x13, 0xBD, 0x45, 0x28, 0x1C, 0x89, 0x1D, 0x7B, 0x43,
+	0xFD, 0x56, 0xDA, 0xE6, 0x1A, 0x91, 0xF5,
+	// Degree 24
+	0x7A, 0x76, 0xA9, 0x46, 0xB2, 0xED, 0xD8, 0x66, 0x73, 0x96, 0xE5, 0x49, 0x82, 0x48, 0x3D,
+	0x2B, 0xCE, 0x01, 0xED, 0xF7, 0x7F, 0xD9, 0x90, 0x75,
+	// Degree 26
+	0xF6, 0x33, 0xB7, 0x04, 0x88, 0x62, 0xC7, 0x98, 0x4D, 0x38, 0xCE, 0x18, 0x91, 0x28, 0xD1,
+	0x75, 0xE9, 0x2A, 0x87, 0x44, 0x46, 0x90, 0x92, 0x4D, 0x2B, 0x5E,
+	// Degree 28
+	0xFC, 0x09, 0x1C, 0x0D, 0x12, 0xFB, 0xD0, 0x96, 0x67, 0xAE, 0x64, 0x29, 0xA7, 0x0C, 0xF7,
+	0x38, 0x75, 0x77, 0xE9, 0x7F, 0xB5, 0x64, 0x79, 0x93, 0xB0, 0x4A, 0x3A, 0xC5,
+	// Degree 30
+	0xD4, 0xF6, 0x4D, 0x49, 0xC3, 0xC0, 0x4B, 0x62, 0x05, 0x46, 0x67, 0xB1, 0x16, 0xD9, 0x8A,
+	0x33, 0xB5, 0xF6, 0x48, 0x19, 0x12, 0x2E, 0xE4, 0x4A, 0xD8, 0xC3, 0x0B, 0x6A, 0x82, 0x96,
+};
+
+// Offset of the generator polynomial of each degree in RS_GENERATORS, or 0xFF if there is none.
+static const uint8_t RS_GENERATOR_OFFSETS[31] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0, 0xFF, 0xFF, 7, 0xFF, 0xFF, 17, 0xFF, 30,
+	45, 61, 78, 0xFF, 96, 0xFF, 116, 0xFF, 138, 0xFF, 162, 0xFF, 188, 0xFF, 216,
+};
+#endif
+
 
 
 /*---- High-level QR Code encoding functions ----*/
@@ -163,6 +438,159 @@ fail:
 }
 
 
+// Public function - see documentation comment in header file.
+bool qrcodegen_encodeTextOptimal(const char *text, uint8_t tempBuffer[], uint8_t qrcode[],
+		enum qrcodegen_Ecc ecl, int minVersion, int maxVersion, enum qrcodegen_Mask mask, bool boostEcl) {
+	assert(text != NULL && tempBuffer != NULL && qrcode != NULL);
+	assert(qrcodegen_VERSION_MIN <= minVersion && minVersion <= maxVersion && maxVersion <= qrcodegen_VERSION_MAX);
+	assert(0 <= (int)ecl && (int)ecl <= 3 && -2 <= (int)mask && (int)mask <= 7);
+
+	// The mode of every character is kept in tempBuffer, so text that cannot be
+	// in byte mode anyway is left to qrcodegen_encodeText() to reject
+	size_t textLen = strlen(text);
+	size_t bufLen = qrcodegen_BUFFER_LEN_FOR_VERSION(maxVersion);
+	if (textLen == 0 || textLen > bufLen)
+		return qrcodegen_encodeText(text, tempBuffer, qrcode, ecl, minVersion, maxVersion, mask, boostEcl);
+
+	// Find the minimal version number to use. The segmentation only depends on the
+	// widths of the character count fields, which change at versions 10 and 27.
+	int version, dataUsedBits = -1;
+	for (version = minVersion; ; version++) {
+		if (version == minVersion || version == 10 || version == 27) {
+			long bits = getOptimalModes(text, textLen, version, tempBuffer);
+			if (bits <= INT16_MAX && fitsCharCountFields(tempBuffer, textLen, version))
+				dataUsedBits = (int)bits;
+			else
+				dataUsedBits = -1;
+		}
+		if (dataUsedBits != -1 && dataUsedBits <= getNumDataCodewords(version, ecl) * 8)
+			break;  // This version number is found to be suitable
+		if (version >= maxVersion) {  // All versions in the range could not fit the given data
+			qrcode[0] = 0;  // Set size to invalid value for safety
+			return false;
+		}
+	}
+
+	// Increase the error correction level while the data still fits in the current version number
+	for (int i = (int)qrcodegen_Ecc_MEDIUM; i <= (int)qrcodegen_Ecc_HIGH; i++) {
+		if (boostEcl && dataUsedBits <= getNumDataCodewords(version, (enum qrcodegen_Ecc)i) * 8)
+			ecl = (enum qrcodegen_Ecc)i;
+	}
+
+	// Create the data bit string from the runs of characters in the same mode
+	memset(qrcode, 0, qrcodegen_BUFFER_LEN_FOR_VERSION(version) * sizeof(qrcode[0]));
+	int bitLen = 0;
+	for (size_t start = 0, end; start < textLen; start = end) {
+		for (end = start + 1; end < textLen && tempBuffer[end] == tempBuffer[start]; end++);
+		appendSegmentBits(OPTIMAL_MODES[tempBuffer[start]], &text[start], end - start, version, qrcode, &bitLen);
+	}
+	assert(bitLen == dataUsedBits);
+
+	drawSymbol(qrcode, bitLen, version, ecl, mask, tempBuffer);
+	return true;
+}
+
+
+// Computes the split of the given text into numeric, alphanumeric and byte segments
+// with the fewest bits at the given version, and returns that number of bits. This is
+// the dynamic programming of Nayuki's QrSegmentAdvanced.makeSegmentsOptimally(), with
+// costs in sixths of a bit so that numeric and alphanumeric characters cost whole units.
+// If modes is not NULL, then it receives the index into OPTIMAL_MODES of each character.
+NOINLINE static long getOptimalModes(const char *text, size_t len, int version, uint8_t modes[]) {
+	static const int CHAR_COSTS[3] = {20, 33, 48};  // 10/3, 11/2 and 8 bits
+	long headCosts[3], prevCosts[3];
+	for (int m = 0; m < 3; m++) {
+		headCosts[m] = (4 + numCharCountBits(OPTIMAL_MODES[m], version)) * 6L;
+		prevCosts[m] = headCosts[m];
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		// from[m] is the mode of character i on the cheapest path that is in mode m after it, or 3 if none
+		uint8_t from[3] = {3, 3, 3};
+		long curCosts[3] = {0, 0, 0};
+		char c = text[i];
+		if ('0' <= c && c <= '9') {
+			curCosts[0] = prevCosts[0] + CHAR_COSTS[0];
+			from[0] = 0;
+		}
+		if (c != '\0' && strchr(ALPHANUMERIC_CHARSET, c) != NULL) {
+			curCosts[1] = prevCosts[1] + CHAR_COSTS[1];
+			from[1] = 1;
+		}
+		curCosts[2] = prevCosts[2] + CHAR_COSTS[2];
+		from[2] = 2;
+
+		// Switching modes after this character pads the old segment to whole bits and starts a new one
+		for (int j = 0; j < 3; j++) {
+			for (int k = 0; k < 3; k++) {
+				long newCost = (curCosts[k] + 5) / 6 * 6 + headCosts[j];
+				if (from[k] != 3 && (from[j] == 3 || newCost < curCosts[j])) {
+					curCosts[j] = newCost;
+					from[j] = (uint8_t)k;
+				}
+			}
+		}
+		if (modes != NULL)
+			modes[i] = (uint8_t)(from[0] | from[1] << 2 | from[2] << 4);
+		memcpy(prevCosts, curCosts, sizeof(prevCosts));
+	}
+
+	int best = 0;
+	for (int m = 1; m < 3; m++) {
+		if (prevCosts[m] < prevCosts[best])
+			best = m;
+	}
+	long result = (prevCosts[best] + 5) / 6;
+	if (modes != NULL) {
+		// Walk back from the cheapest final mode, replacing the packed links with the mode of each character
+		for (size_t i = len; i-- > 0; ) {
+			best = (modes[i] >> (best * 2)) & 3;
+			modes[i] = (uint8_t)best;
+		}
+	}
+	return result;
+}
+
+
+// Returns whether every run of characters in the same mode fits in
+// the character count field of that mode at the given version.
+static bool fitsCharCountFields(const uint8_t modes[], size_t len, int version) {
+	for (size_t start = 0, end; start < len; start = end) {
+		for (end = start + 1; end < len && modes[end] == modes[start]; end++);
+		if (end - start >= (1UL << numCharCountBits(OPTIMAL_MODES[modes[start]], version)))
+			return false;
+	}
+	return true;
+}
+
+
+// Public function - see documentation comment in header file.
+int qrcodegen_getMinVersionForText(const char *text, enum qrcodegen_Ecc ecl, int minVersion, int maxVersion) {
+	assert(text != NULL && 0 <= (int)ecl && (int)ecl <= 3);
+	assert(qrcodegen_VERSION_MIN <= minVersion && minVersion <= maxVersion && maxVersion <= qrcodegen_VERSION_MAX);
+
+	size_t textLen = strlen(text);
+	if (textLen == 0)
+		return minVersion;
+	// Same mode choice as qrcodegen_encodeText()
+	enum qrcodegen_Mode mode = qrcodegen_Mode_BYTE;
+	if (qrcodegen_isNumeric(text))
+		mode = qrcodegen_Mode_NUMERIC;
+	else if (qrcodegen_isAlphanumeric(text))
+		mode = qrcodegen_Mode_ALPHANUMERIC;
+	int dataBits = calcSegmentBitLength(mode, textLen);
+	if (dataBits == -1)
+		return 0;
+
+	for (int version = minVersion; version <= maxVersion; version++) {
+		int ccbits = numCharCountBits(mode, version);
+		if (textLen < (1UL << ccbits) && 4 + ccbits + dataBits <= getNumDataCodewords(version, ecl) * 8)
+			return version;
+	}
+	return 0;
+}
+
+
 // Public function - see documentation comment in header file.
 bool qrcodegen_encodeBinary(uint8_t dataAndTemp[], size_t dataLen, uint8_t qrcode[],
 		enum qrcodegen_Ecc ecl, int minVersion, int maxVersion, enum qrcodegen_Mask mask, bool boostEcl) {
@@ -264,8 +692,16 @@ testable int getNumRawDataModules(int version) {
 
 // Calculates the Reed-Solomon generator polynomial of the given degree, storing in result[0 : degree].
 testable void calcReedSolomonGenerator(int degree, uint8_t result[]) {
-	// Start with the monomial x^0
 	assert(1 <= degree && degree <= 30);
+	#if QRCODEGEN_RS_TABLES >= 2
+		// Use the precomputed polynomial if there is one
+		if (RS_GENERATOR_OFFSETS[degree] != 0xFF) {
+			memcpy(result, &RS_GENERATORS[RS_GENERATOR_OFFSETS[degree]], degree * sizeof(result[0]));
+			return;
+		}
+	#endif
+
+	// Start with the monomial x^0
 	memset(result, 0, degree * sizeof(result[0]));
 	result[degree - 1] = 1;
 
@@ -293,12 +729,29 @@ testable void calcReedSolomonRemainder(const uint8_t data[], int dataLen,
 	// Perform polynomial division
 	assert(1 <= degree && degree <= 30);
 	memset(result, 0, degree * sizeof(result[0]));
+	#if QRCODEGEN_RS_TABLES >= 1
+		// Every generator coefficient is non-zero, so it can be
+		// kept as a logarithm and each product is one table lookup
+		uint8_t generatorLog[30];
+		for (int j = 0; j < degree; j++) {
+			assert(generator[j] != 0);
+			generatorLog[j] = RS_LOG[generator[j]];
+		}
+	#endif
 	for (int i = 0; i < dataLen; i++) {
 		uint8_t factor = data[i] ^ result[0];
 		memmove(&result[0], &result[1], (degree - 1) * sizeof(result[0]));
 		result[degree - 1] = 0;
-		for (int j = 0; j < degree; j++)
-			result[j] ^= finiteFieldMultiply(generator[j], factor);
+		#if QRCODEGEN_RS_TABLES >= 1
+			if (factor == 0)
+				continue;
+			const uint8_t *exp = &RS_EXP[RS_LOG[factor]];
+			for (int j = 0; j < degree; j++)
+				result[j] ^= exp[generatorLog[j]];
+		#else
+			for (int j = 0; j < degree; j++)
+				result[j] ^= finiteFieldMultiply(generator[j], factor);
+		#endif
 	}
 }
 
@@ -306,13 +759,19 @@ testable void calcReedSolomonRemainder(const uint8_t data[], int dataLen,
 // Returns the product of the two given field elements modulo GF(2^8/0x11D).
 // All inputs are valid. This could be implemented as a 256*256 lookup table.
 testable uint8_t finiteFieldMultiply(uint8_t x, uint8_t y) {
-	// Russian peasant multiplication
-	uint8_t z = 0;
-	for (int i = 7; i >= 0; i--) {
-		z = (z << 1) ^ ((z >> 7) * 0x11D);
-		z ^= ((y >> i) & 1) * x;
-	}
-	return z;
+	#if QRCODEGEN_RS_TABLES >= 1
+		if (x == 0 || y == 0)
+			return 0;
+		return RS_EXP[RS_LOG[x] + RS_LOG[y]];
+	#else
+		// Russian peasant multiplication
+		uint8_t z = 0;
+		for (int i = 7; i >= 0; i--) {
+			z = (z << 1) ^ ((z >> 7) * 0x11D);
+			z ^= ((y >> i) & 1) * x;
+		}
+		return z;
+	#endif
 }
 
 
@@ -324,7 +783,7 @@ testable uint8_t finiteFieldMultiply(uint8_t x, uint8_t y) {
 testable void initializeFunctionModules(int version, uint8_t qrcode[]) {
 	// Initialize QR Code
 	int qrsize = version * 4 + 17;
-	memset(qrcode, 0, ((qrsize * qrsize + 7) / 8 + 1) * sizeof(qrcode[0]));
+	memset(qrcode, 0, qrcodegen_BUFFER_LEN_FOR_VERSION(version) * sizeof(qrcode[0]));
 	qrcode[0] = (uint8_t)qrsize;
 
 	// Fill horizontal and vertical timing patterns
@@ -481,33 +940,60 @@ testable int getAlignmentPatternPositions(int version, uint8_t result[7]) {
 
 // Sets every pixel in the range [left : left + width] * [top : top + height] to black.
 static void fillRectangle(int left, int top, int width, int height, uint8_t qrcode[]) {
+	int qrsize = qrcodegen_getSize(qrcode);
+	assert(0 <= left && left + width <= qrsize && 0 <= top && top + height <= qrsize);
+	int rowWords = getRowWords(qrsize);
 	for (int dy = 0; dy < height; dy++) {
-		for (int dx = 0; dx < width; dx++)
-			setModule(qrcode, left + dx, top + dy, true);
+		int rowStart = (top + dy) * rowWords;
+		// Set the range one word at a time
+		for (int x = left, end = left + width; x < end; ) {
+			int count = 32 - (x & 31);
+			if (count > end - x)
+				count = end - x;
+			uint32_t bits = count == 32 ? UINT32_MAX : (UINT32_C(1) << count) - 1;
+			int i = rowStart + (x >> 5);
+			setRowWord(qrcode, i, getRowWord(qrcode, i) | bits << (x & 31));
+			x += count;
+		}
 	}
 }
 
 
 
+// Clears the given QR Code grid for the given version and copies the rows of the given
+// template plane into it. Requires version <= qrcodegen_TEMPLATE_VERSION_MAX.
+static void copyTemplate(const uint32_t plane[], int version, uint8_t qrcode[]) {
+	assert(1 <= version && version <= qrcodegen_TEMPLATE_VERSION_MAX);
+	int start = qrcodegen_TEMPLATE_OFFSETS[version - 1];
+	memset(qrcode, 0, 4);
+	qrcode[0] = (uint8_t)(version * 4 + 17);
+	memcpy(&qrcode[4], &plane[start], (size_t)(qrcodegen_TEMPLATE_OFFSETS[version] - start) * sizeof(plane[0]));
+}
+
+
 /*---- Drawing data modules and masking ----*/
 
 // Draws the raw codewords (including data and ECC) onto the given QR Code. This requires the initial state of
 // the QR Code to be black at function modules and white at codeword modules (including unused remainder bits).
 static void drawCodewords(const uint8_t data[], int dataLen, uint8_t qrcode[]) {
 	int qrsize = qrcodegen_getSize(qrcode);
+	int rowWords = getRowWords(qrsize);
 	int i = 0;  // Bit index into the data
 	// Do the funny zigzag scan
 	for (int right = qrsize - 1; right >= 1; right -= 2) {  // Index of right column in each column pair
 		if (right == 6)
 			right = 5;
+		bool upward = ((right + 1) & 2) == 0;
 		for (int vert = 0; vert < qrsize; vert++) {  // Vertical counter
+			int y = upward ? qrsize - 1 - vert : vert;  // Actual y coordinate
 			for (int j = 0; j < 2; j++) {
 				int x = right - j;  // Actual x coordinate
-				bool upward = ((right + 1) & 2) == 0;
-				int y = upward ? qrsize - 1 - vert : vert;  // Actual y coordinate
-				if (!getModule(qrcode, x, y) && i < dataLen * 8) {
-					bool black = getBit(data[i >> 3], 7 - (i & 7));
-					setModule(qrcode, x, y, black);
+				int w = y * rowWords + (x >> 5);
+				uint32_t word = getRowWord(qrcode, w);
+				uint32_t bit = UINT32_C(1) << (x & 31);
+				if ((word & bit) == 0 && i < dataLen * 8) {
+					if (getBit(data[i >> 3], 7 - (i & 7)))
+						setRowWord(qrcode, w, word | bit);
 					i++;
 				}
 				// If there are any remainder bits (0 to 7), they are already
@@ -523,107 +1009,133 @@ static void drawCodewords(const uint8_t data[], int dataLen, uint8_t qrcode[]) {
 // properties, calling applyMask(..., m) twice with the same value is equivalent to no change at all.
 // This means it is possible to apply a mask, undo it, and try another mask. Note that a final
 // well-formed QR Code symbol needs exactly one mask applied (not zero, not two, etc.).
+// The mask is applied one word of 32 modules at a time, using the precomputed MASK_PATTERNS.
 static void applyMask(const uint8_t functionModules[], uint8_t qrcode[], enum qrcodegen_Mask mask) {
-	assert(0 <= (int)mask && (int)mask <= 7);  // Disallows qrcodegen_Mask_AUTO
+	assert(0 <= (int)mask && (int)mask <= 7);  // Disallows qrcodegen_Mask_AUTO and qrcodegen_Mask_FAST
 	int qrsize = qrcodegen_getSize(qrcode);
-	for (int y = 0; y < qrsize; y++) {
-		for (int x = 0; x < qrsize; x++) {
-			if (getModule(functionModules, x, y))
-				continue;
-			bool invert = false;  // Dummy value
-			switch ((int)mask) {
-				case 0:  invert = (x + y) % 2 == 0;                    break;
-				case 1:  invert = y % 2 == 0;                          break;
-				case 2:  invert = x % 3 == 0;                          break;
-				case 3:  invert = (x + y) % 3 == 0;                    break;
-				case 4:  invert = (x / 3 + y / 2) % 2 == 0;            break;
-				case 5:  invert = x * y % 2 + x * y % 3 == 0;          break;
-				case 6:  invert = (x * y % 2 + x * y % 3) % 2 == 0;    break;
-				case 7:  invert = ((x + y) % 2 + x * y % 3) % 2 == 0;  break;
-				default:  assert(false);
-			}
-			bool val = getModule(qrcode, x, y);
-			setModule(qrcode, x, y, val ^ invert);
+	int rowWords = getRowWords(qrsize);
+	uint32_t lastWordBits = (qrsize & 31) == 0 ? UINT32_MAX : (UINT32_C(1) << (qrsize & 31)) - 1;
+	for (int y = 0, i = 0, patternRow = 0; y < qrsize; y++) {
+		const uint32_t *pattern = MASK_PATTERNS[(int)mask][patternRow];
+		for (int w = 0, patternWord = 0; w < rowWords; w++, i++) {
+			uint32_t invert = pattern[patternWord] & ~getRowWord(functionModules, i);
+			if (w == rowWords - 1)
+				invert &= lastWordBits;  // Keep the padding after the last module white
+			setRowWord(qrcode, i, getRowWord(qrcode, i) ^ invert);
+			if (++patternWord == 3)
+				patternWord = 0;
 		}
+		if (++patternRow == 12)
+			patternRow = 0;
 	}
 }
 
 
 // Calculates and returns the penalty score based on state of the given QR Code's current modules.
 // This is used by the automatic mask choice algorithm to find the mask pattern that yields the lowest score.
-static long getPenaltyScore(const uint8_t qrcode[]) {
+// Rows are scored 32 modules at a time with shifts and bit counts, and columns are scored 32 at a time by
+// treating every bit position of a word as its own column. Scoring stops as soon as the result reaches
+// limit, because such a mask can no longer be chosen. If rowsOnly is true, runs and finder-like patterns
+// in columns are skipped, which gives the cheaper estimate used by qrcodegen_Mask_FAST.
+static long getPenaltyScore(const uint8_t qrcode[], long limit, bool rowsOnly) {
 	int qrsize = qrcodegen_getSize(qrcode);
+	int rowWords = getRowWords(qrsize);
 	long result = 0;
 
-	// Adjacent modules in row having same color
+	// Bits where a pair of adjacent modules starts, and where an 11-module window starts
+	uint32_t pairBits[MAX_ROW_WORDS], windowBits[MAX_ROW_WORDS];
+	setLowBits(qrsize - 1, rowWords, pairBits);
+	setLowBits(qrsize - 10, rowWords, windowBits);
+
+	// Bit x of shifted[k - 1] is module x + k of the current row, and of prevNext is module x + 1 of the previous row
+	uint32_t shifted[6][MAX_ROW_WORDS], prevNext[MAX_ROW_WORDS];
+	uint32_t core[MAX_ROW_WORDS], white[MAX_ROW_WORDS], temp[MAX_ROW_WORDS];
+	uint32_t row[MAX_ROW_WORDS];
 	for (int y = 0; y < qrsize; y++) {
-		bool colorX = false;
-		for (int x = 0, runX = -1; x < qrsize; x++) {
-			if (x == 0 || getModule(qrcode, x, y) != colorX) {
-				colorX = getModule(qrcode, x, y);
-				runX = 1;
-			} else {
-				runX++;
-				if (runX == 5)
-					result += PENALTY_N1;
-				else if (runX > 5)
-					result++;
+		getRow(qrcode, y, rowWords, row);
+		for (int k = 1; k <= 6; k++)
+			shiftRow(row, rowWords, k, shifted[k - 1]);
+		const uint32_t *next = shifted[0];
+
+		// Adjacent modules in row having same color, where every color change ends a run
+		int runStart = 0;
+		for (int w = 0; w < rowWords; w++) {
+			for (uint32_t changes = (row[w] ^ next[w]) & pairBits[w]; changes != 0; changes &= changes - 1) {
+				int runEnd = w * 32 + countBits((changes & (0 - changes)) - 1) + 1;
+				result += getRunPenalty(runEnd - runStart);
+				runStart = runEnd;
 			}
 		}
-	}
-	// Adjacent modules in column having same color
-	for (int x = 0; x < qrsize; x++) {
-		bool colorY = false;
-		for (int y = 0, runY = -1; y < qrsize; y++) {
-			if (y == 0 || getModule(qrcode, x, y) != colorY) {
-				colorY = getModule(qrcode, x, y);
-				runY = 1;
-			} else {
-				runY++;
-				if (runY == 5)
-					result += PENALTY_N1;
-				else if (runY > 5)
-					result++;
+		result += getRunPenalty(qrsize - runStart);
+
+		// 2*2 blocks of modules having same color, with this row as the bottom one
+		if (y > 0) {
+			for (int w = 0; w < rowWords; w++) {
+				uint32_t blocks = ~(getRowWord(qrcode, (y - 1) * rowWords + w) ^ row[w]) & ~(prevNext[w] ^ next[w])
+					& ~(row[w] ^ next[w]) & pairBits[w];
+				result += PENALTY_N2 * countBits(blocks);
 			}
 		}
-	}
+		memcpy(prevNext, next, rowWords * sizeof(uint32_t));
 
-	// 2*2 blocks of modules having same color
-	for (int y = 0; y < qrsize - 1; y++) {
-		for (int x = 0; x < qrsize - 1; x++) {
-			bool  color = getModule(qrcode, x, y);
-			if (  color == getModule(qrcode, x + 1, y) &&
-			      color == getModule(qrcode, x, y + 1) &&
-			      color == getModule(qrcode, x + 1, y + 1))
-				result += PENALTY_N2;
+		// Finder-like pattern in row: core 1011101 preceded or followed by 4 white modules
+		for (int w = 0; w < rowWords; w++) {
+			core[w] = row[w] & ~shifted[0][w] & shifted[1][w] & shifted[2][w]
+				& shifted[3][w] & ~shifted[4][w] & shifted[5][w];
+			white[w] = ~(row[w] | shifted[0][w] | shifted[1][w] | shifted[2][w]);
 		}
+		shiftRow(core, rowWords, 4, temp);
+		for (int w = 0; w < rowWords; w++)
+			result += PENALTY_N3 * countBits(white[w] & temp[w] & windowBits[w]);
+		shiftRow(white, rowWords, 7, temp);
+		for (int w = 0; w < rowWords; w++)
+			result += PENALTY_N3 * countBits(core[w] & temp[w] & windowBits[w]);
 	}
+	if (result >= limit)
+		return result;
+
+	if (!rowsOnly) {
+		uint32_t lastWordBits = (qrsize & 31) == 0 ? UINT32_MAX : (UINT32_C(1) << (qrsize & 31)) - 1;
+		for (int w = 0; w < rowWords; w++) {
+			uint32_t valid = w == rowWords - 1 ? lastWordBits : UINT32_MAX;
+
+			// Adjacent modules in column having same color. The run length of every column
+			// is kept as min(length, 6) - 1 in three bit planes, counting up from 0 to 5
+			uint32_t len0 = 0, len1 = 0, len2 = 0;
+			for (int y = 1; y < qrsize; y++) {
+				uint32_t same = ~(getRowWord(qrcode, (y - 1) * rowWords + w) ^ getRowWord(qrcode, y * rowWords + w));
+				uint32_t saturated = len2 & len0;
+				uint32_t grow = same & ~saturated;
+				uint32_t keep = same & saturated;
+				uint32_t carry = len1 & len0;
+				len1 = (grow & (len1 ^ len0)) | (keep & len1);
+				len2 = (grow & (len2 ^ carry)) | (keep & len2);
+				len0 = (grow & ~len0) | (keep & len0);
+				result += PENALTY_N1 * countBits(len2 & ~len1 & ~len0 & valid);  // Length 5
+				result += countBits(len2 & len0 & valid);  // Length 6 or more
+			}
 
-	// Finder-like pattern in rows
-	for (int y = 0; y < qrsize; y++) {
-		for (int x = 0, bits = 0; x < qrsize; x++) {
-			bits = ((bits << 1) & 0x7FF) | (getModule(qrcode, x, y) ? 1 : 0);
-			if (x >= 10 && (bits == 0x05D || bits == 0x5D0))  // Needs 11 bits accumulated
-				result += PENALTY_N3;
-		}
-	}
-	// Finder-like pattern in columns
-	for (int x = 0; x < qrsize; x++) {
-		for (int y = 0, bits = 0; y < qrsize; y++) {
-			bits = ((bits << 1) & 0x7FF) | (getModule(qrcode, x, y) ? 1 : 0);
-			if (y >= 10 && (bits == 0x05D || bits == 0x5D0))  // Needs 11 bits accumulated
-				result += PENALTY_N3;
+			// Finder-like pattern in column, where r[k] is word w of row y - 10 + k. Padding
+			// columns are all white, so they never match the black modules of the core
+			for (int y = 10; y < qrsize; y++) {
+				uint32_t r[11];
+				for (int k = 0; k < 11; k++)
+					r[k] = getRowWord(qrcode, (y - 10 + k) * rowWords + w);
+				uint32_t core0 = r[0] & ~r[1] & r[2] & r[3] & r[4] & ~r[5] & r[6];
+				uint32_t core4 = r[4] & ~r[5] & r[6] & r[7] & r[8] & ~r[9] & r[10];
+				uint32_t white0 = ~(r[0] | r[1] | r[2] | r[3]);
+				uint32_t white7 = ~(r[7] | r[8] | r[9] | r[10]);
+				result += PENALTY_N3 * (countBits(white0 & core4) + countBits(core0 & white7));
+			}
 		}
+		if (result >= limit)
+			return result;
 	}
 
 	// Balance of black and white modules
 	int black = 0;
-	for (int y = 0; y < qrsize; y++) {
-		for (int x = 0; x < qrsize; x++) {
-			if (getModule(qrcode, x, y))
-				black++;
-		}
-	}
+	for (int i = 0; i < qrsize * rowWords; i++)
+		black += countBits(getRowWord(qrcode, i));
 	int total = qrsize * qrsize;
 	// Find smallest k such that (45-5k)% <= dark/total <= (55+5k)%
 	for (int k = 0; black*20L < (9L-k)*total || black*20L > (11L+k)*total; k++)
@@ -632,6 +1144,45 @@ static long getPenaltyScore(const uint8_t qrcode[]) {
 }
 
 
+// Returns the penalty for a run of the given number of adjacent modules having same color.
+static long getRunPenalty(int length) {
+	return length < 5 ? 0 : PENALTY_N1 + (length - 5);
+}
+
+
+// Stores the given row shifted by k modules into result, so that bit x of the result is
+// module x + k of the row, or 0 past the end of the row. Requires 0 < k < 32.
+static void shiftRow(const uint32_t row[], int rowWords, int k, uint32_t result[]) {
+	assert(0 < k && k < 32);
+	for (int w = 0; w < rowWords; w++) {
+		uint32_t next = w + 1 < rowWords ? row[w + 1] : 0;
+		result[w] = row[w] >> k | next << (32 - k);
+	}
+}
+
+
+// Sets bits 0 to count - 1 of the row of words in result, and clears the rest.
+static void setLowBits(int count, int rowWords, uint32_t result[]) {
+	for (int w = 0; w < rowWords; w++, count -= 32) {
+		if (count >= 32)
+			result[w] = UINT32_MAX;
+		else if (count > 0)
+			result[w] = (UINT32_C(1) << count) - 1;
+		else
+			result[w] = 0;
+	}
+}
+
+
+// Returns the number of set bits in the given word.
+static int countBits(uint32_t x) {
+	x = x - ((x >> 1) & UINT32_C(0x55555555));
+	x = (x & UINT32_C(0x33333333)) + ((x >> 2) & UINT32_C(0x33333333));
+	x = (x + (x >> 4)) & UINT32_C(0x0F0F0F0F);
+	return (int)((x * UINT32_C(0x01010101)) >> 24);
+}
+
+
 
 /*---- Basic QR Code information ----*/
 
@@ -653,12 +1204,28 @@ bool qrcodegen_getModule(const uint8_t qrcode[], int x, int y) {
 }
 
 
+// Public function - see documentation comment in header file.
+void qrcodegen_initSymbol(uint8_t qrcode[], int size) {
+	assert(qrcode != NULL && ((uintptr_t)qrcode & 3) == 0);
+	assert((qrcodegen_VERSION_MIN * 4 + 17) <= size && size <= (qrcodegen_VERSION_MAX * 4 + 17) && (size - 17) % 4 == 0);
+	memset(qrcode, 0, qrcodegen_BUFFER_LEN_FOR_VERSION((size - 17) / 4) * sizeof(qrcode[0]));
+	qrcode[0] = (uint8_t)size;
+}
+
+
+// Public function - see documentation comment in header file.
+void qrcodegen_setModule(uint8_t qrcode[], int x, int y, bool isBlack) {
+	assert(qrcode != NULL);
+	setModuleBounded(qrcode, x, y, isBlack);
+}
+
+
 // Gets the module at the given coordinates, which must be in bounds.
 testable bool getModule(const uint8_t qrcode[], int x, int y) {
 	int qrsize = qrcode[0];
 	assert(21 <= qrsize && qrsize <= 177 && 0 <= x && x < qrsize && 0 <= y && y < qrsize);
-	int index = y * qrsize + x;
-	return getBit(qrcode[(index >> 3) + 1], index & 7);
+	uint32_t word = getRowWord(qrcode, y * getRowWords(qrsize) + (x >> 5));
+	return ((word >> (x & 31)) & 1) != 0;
 }
 
 
@@ -666,13 +1233,13 @@ testable bool getModule(const uint8_t qrcode[], int x, int y) {
 testable void setModule(uint8_t qrcode[], int x, int y, bool isBlack) {
 	int qrsize = qrcode[0];
 	assert(21 <= qrsize && qrsize <= 177 && 0 <= x && x < qrsize && 0 <= y && y < qrsize);
-	int index = y * qrsize + x;
-	int bitIndex = index & 7;
-	int byteIndex = (index >> 3) + 1;
+	int i = y * getRowWords(qrsize) + (x >> 5);
+	uint32_t word = getRowWord(qrcode, i);
 	if (isBlack)
-		qrcode[byteIndex] |= 1 << bitIndex;
+		word |= UINT32_C(1) << (x & 31);
 	else
-		qrcode[byteIndex] &= (1 << bitIndex) ^ 0xFF;
+		word &= ~(UINT32_C(1) << (x & 31));
+	setRowWord(qrcode, i, word);
 }
 
 
@@ -684,6 +1251,38 @@ testable void setModuleBounded(uint8_t qrcode[], int x, int y, bool isBlack) {
 }
 
 
+// Returns the number of 32-bit words that store one row of modules of a QR Code with the given side length.
+static int getRowWords(int qrsize) {
+	return (qrsize + 31) >> 5;
+}
+
+
+// Returns word i of the rows of modules of the given QR Code, which follow the 4-byte header that holds the size.
+// Every row starts on a new word, and module (x, y) is bit (x % 32) of word (y * getRowWords(size) + x / 32).
+// Padding bits after the last module of each row are always 0. The words are copied with memcpy, so the byte
+// buffer is never accessed through a uint32_t lvalue, but the buffer must be aligned to 4 bytes.
+static uint32_t getRowWord(const uint8_t qrcode[], int i) {
+	assert(((uintptr_t)qrcode & 3) == 0);
+	uint32_t result;
+	memcpy(&result, ALIGNED_WORD(&qrcode[4 + i * 4]), sizeof(result));
+	return result;
+}
+
+
+// Stores word i of the rows of modules of the given QR Code, see getRowWord().
+static void setRowWord(uint8_t qrcode[], int i, uint32_t word) {
+	assert(((uintptr_t)qrcode & 3) == 0);
+	memcpy(ALIGNED_WORD(&qrcode[4 + i * 4]), &word, sizeof(word));
+}
+
+
+// Copies the rowWords words of row y of the given QR Code into result.
+static void getRow(const uint8_t qrcode[], int y, int rowWords, uint32_t result[]) {
+	assert(((uintptr_t)qrcode & 3) == 0);
+	memcpy(result, ALIGNED_WORD(&qrcode[4 + y * rowWords * 4]), (size_t)rowWords * sizeof(result[0]));
+}
+
+
 // Returns true iff the i'th bit of x is set to 1.
 static bool getBit(int x, int i) {
 	return ((x >> i) & 1) != 0;
@@ -802,22 +1401,7 @@ struct qrcodegen_Segment qrcodegen_makeNumeric(const char *digits, uint8_t buf[]
 	if (bitLen > 0)
 		memset(buf, 0, ((size_t)bitLen + 7) / 8 * sizeof(buf[0]));
 	result.bitLength = 0;
-
-	unsigned int accumData = 0;
-	int accumCount = 0;
-	for (; *digits != '\0'; digits++) {
-		char c = *digits;
-		assert('0' <= c && c <= '9');
-		accumData = accumData * 10 + (c - '0');
-		accumCount++;
-		if (accumCount == 3) {
-			appendBitsToBuffer(accumData, 10, buf, &result.bitLength);
-			accumData = 0;
-			accumCount = 0;
-		}
-	}
-	if (accumCount > 0)  // 1 or 2 digits remaining
-		appendBitsToBuffer(accumData, accumCount * 3 + 1, buf, &result.bitLength);
+	appendNumericBits(digits, len, buf, &result.bitLength);
 	assert(result.bitLength == bitLen);
 	result.data = buf;
 	return result;
@@ -836,25 +1420,75 @@ struct qrcodegen_Segment qrcodegen_makeAlphanumeric(const char *text, uint8_t bu
 	if (bitLen > 0)
 		memset(buf, 0, ((size_t)bitLen + 7) / 8 * sizeof(buf[0]));
 	result.bitLength = 0;
+	appendAlphanumericBits(text, len, buf, &result.bitLength);
+	assert(result.bitLength == bitLen);
+	result.data = buf;
+	return result;
+}
+
 
+// Appends the numeric mode data bits of the given len digits to the given buffer.
+static void appendNumericBits(const char *digits, size_t len, uint8_t buf[], int *bitLen) {
 	unsigned int accumData = 0;
 	int accumCount = 0;
-	for (; *text != '\0'; text++) {
-		const char *temp = strchr(ALPHANUMERIC_CHARSET, *text);
+	for (size_t i = 0; i < len; i++) {
+		char c = digits[i];
+		assert('0' <= c && c <= '9');
+		accumData = accumData * 10 + (c - '0');
+		accumCount++;
+		if (accumCount == 3) {
+			appendBitsToBuffer(accumData, 10, buf, bitLen);
+			accumData = 0;
+			accumCount = 0;
+		}
+	}
+	if (accumCount > 0)  // 1 or 2 digits remaining
+		appendBitsToBuffer(accumData, accumCount * 3 + 1, buf, bitLen);
+}
+
+
+// Appends the alphanumeric mode data bits of the given len characters to the given buffer.
+static void appendAlphanumericBits(const char *text, size_t len, uint8_t buf[], int *bitLen) {
+	unsigned int accumData = 0;
+	int accumCount = 0;
+	for (size_t i = 0; i < len; i++) {
+		const char *temp = text[i] != '\0' ? strchr(ALPHANUMERIC_CHARSET, text[i]) : NULL;
 		assert(temp != NULL);
 		accumData = accumData * 45 + (temp - ALPHANUMERIC_CHARSET);
 		accumCount++;
 		if (accumCount == 2) {
-			appendBitsToBuffer(accumData, 11, buf, &result.bitLength);
+			appendBitsToBuffer(accumData, 11, buf, bitLen);
 			accumData = 0;
 			accumCount = 0;
 		}
 	}
 	if (accumCount > 0)  // 1 character remaining
-		appendBitsToBuffer(accumData, 6, buf, &result.bitLength);
-	assert(result.bitLength == bitLen);
-	result.data = buf;
-	return result;
+		appendBitsToBuffer(accumData, 6, buf, bitLen);
+}
+
+
+// Appends the mode indicator, character count and data bits of the given
+// len characters as one segment in the given mode to the given buffer.
+static void appendSegmentBits(enum qrcodegen_Mode mode, const char *text, size_t len, int version, uint8_t buf[], int *bitLen) {
+	switch (mode) {
+		case qrcodegen_Mode_NUMERIC:
+			appendBitsToBuffer(0x1, 4, buf, bitLen);
+			appendBitsToBuffer((unsigned int)len, numCharCountBits(mode, version), buf, bitLen);
+			appendNumericBits(text, len, buf, bitLen);
+			break;
+		case qrcodegen_Mode_ALPHANUMERIC:
+			appendBitsToBuffer(0x2, 4, buf, bitLen);
+			appendBitsToBuffer((unsigned int)len, numCharCountBits(mode, version), buf, bitLen);
+			appendAlphanumericBits(text, len, buf, bitLen);
+			break;
+		case qrcodegen_Mode_BYTE:
+			appendBitsToBuffer(0x4, 4, buf, bitLen);
+			appendBitsToBuffer((unsigned int)len, numCharCountBits(mode, version), buf, bitLen);
+			for (size_t i = 0; i < len; i++)
+				appendBitsToBuffer((uint8_t)text[i], 8, buf, bitLen);
+			break;
+		default:  assert(false);
+	}
 }
 
 
@@ -896,7 +1530,7 @@ bool qrcodegen_encodeSegmentsAdvanced(const struct qrcodegen_Segment segs[], siz
 		int minVersion, int maxVersion, int mask, bool boostEcl, uint8_t tempBuffer[], uint8_t qrcode[]) {
 	assert(segs != NULL || len == 0);
 	assert(qrcodegen_VERSION_MIN <= minVersion && minVersion <= maxVersion && maxVersion <= qrcodegen_VERSION_MAX);
-	assert(0 <= (int)ecl && (int)ecl <= 3 && -1 <= (int)mask && (int)mask <= 7);
+	assert(0 <= (int)ecl && (int)ecl <= 3 && -2 <= (int)mask && (int)mask <= 7);
 
 	// Find the minimal version number to use
 	int version, dataUsedBits;
@@ -919,7 +1553,6 @@ bool qrcodegen_encodeSegmentsAdvanced(const struct qrcodegen_Segment segs[], siz
 	}
 
 	// Create the data bit string by concatenating all segments
-	int dataCapacityBits = getNumDataCodewords(version, ecl) * 8;
 	memset(qrcode, 0, qrcodegen_BUFFER_LEN_FOR_VERSION(version) * sizeof(qrcode[0]));
 	int bitLen = 0;
 	for (size_t i = 0; i < len; i++) {
@@ -939,7 +1572,18 @@ bool qrcodegen_encodeSegmentsAdvanced(const struct qrcodegen_Segment segs[], siz
 			appendBitsToBuffer((seg->data[j >> 3] >> (7 - (j & 7))) & 1, 1, qrcode, &bitLen);
 	}
 
+	drawSymbol(qrcode, bitLen, version, ecl, mask, tempBuffer);
+	return true;
+}
+
+
+// Finishes the data bit string of bitLen bits that is at the start of the qrcode buffer
+// with the terminator and padding, adds error correction and draws the symbol. The mask
+// is either fixed or chosen by the penalty score for qrcodegen_Mask_AUTO and qrcodegen_Mask_FAST.
+static void drawSymbol(uint8_t qrcode[], int bitLen, int version, enum qrcodegen_Ecc ecl, int mask, uint8_t tempBuffer[]) {
 	// Add terminator and pad up to a byte if applicable
+	int dataCapacityBits = getNumDataCodewords(version, ecl) * 8;
+	assert(bitLen <= dataCapacityBits);
 	int terminatorBits = dataCapacityBits - bitLen;
 	if (terminatorBits > 4)
 		terminatorBits = 4;
@@ -953,18 +1597,30 @@ bool qrcodegen_encodeSegmentsAdvanced(const struct qrcodegen_Segment segs[], siz
 
 	// Draw function and data codeword modules
 	appendErrorCorrection(qrcode, version, ecl, tempBuffer);
-	initializeFunctionModules(version, qrcode);
-	drawCodewords(tempBuffer, getNumRawDataModules(version) / 8, qrcode);
-	drawWhiteFunctionModules(qrcode, version);
-	initializeFunctionModules(version, tempBuffer);
+	if (version <= qrcodegen_TEMPLATE_VERSION_MAX) {
+		// Start from the generated templates instead of drawing the function patterns
+		copyTemplate(qrcodegen_TEMPLATE_RESERVED, version, qrcode);
+		drawCodewords(tempBuffer, getNumRawDataModules(version) / 8, qrcode);
+		const uint32_t *reserved = &qrcodegen_TEMPLATE_RESERVED[qrcodegen_TEMPLATE_OFFSETS[version - 1]];
+		const uint32_t *pattern = &qrcodegen_TEMPLATE_PATTERNS[qrcodegen_TEMPLATE_OFFSETS[version - 1]];
+		for (int i = 0, end = qrcodegen_TEMPLATE_OFFSETS[version] - qrcodegen_TEMPLATE_OFFSETS[version - 1]; i < end; i++)
+			setRowWord(qrcode, i, getRowWord(qrcode, i) & (~reserved[i] | pattern[i]));  // Whiten the function modules that the pattern has white
+		copyTemplate(qrcodegen_TEMPLATE_RESERVED, version, tempBuffer);
+	} else {
+		initializeFunctionModules(version, qrcode);
+		drawCodewords(tempBuffer, getNumRawDataModules(version) / 8, qrcode);
+		drawWhiteFunctionModules(qrcode, version);
+		initializeFunctionModules(version, tempBuffer);
+	}
 
 	// Handle masking
-	if (mask == qrcodegen_Mask_AUTO) {  // Automatically choose best mask
+	if (mask == qrcodegen_Mask_AUTO || mask == qrcodegen_Mask_FAST) {  // Automatically choose best mask
+		bool rowsOnly = mask == qrcodegen_Mask_FAST;
 		long minPenalty = LONG_MAX;
 		for (int i = 0; i < 8; i++) {
 			drawFormatBits(ecl, (enum qrcodegen_Mask)i, qrcode);
 			applyMask(tempBuffer, qrcode, (enum qrcodegen_Mask)i);
-			long penalty = getPenaltyScore(qrcode);
+			long penalty = getPenaltyScore(qrcode, minPenalty, rowsOnly);
 			if (penalty < minPenalty) {
 				mask = (enum qrcodegen_Mask)i;
 				minPenalty = penalty;
@@ -975,7 +1631,6 @@ bool qrcodegen_encodeSegmentsAdvanced(const struct qrcodegen_Segment segs[], siz
 	assert(0 <= (int)mask && (int)mask <= 7);
 	drawFormatBits(ecl, mask, qrcode);
 	applyMask(tempBuffer, qrcode, mask);
-	return true;
 }
 
 
@@ -0,0 +1,74 @@
+/*
+Queue of work deferred from the radio subscription handlers
+*/
+
+#include <work_queue.h>
+#include <string.h>
+
+static void work_queue_task(void *param);
+
+void work_queue_init(work_queue_t *self, twr_tick_t delay)
+{
+    memset(self, 0, sizeof(*self));
+
+    self->delay = delay;
+    self->task_id = twr_scheduler_register(work_queue_task, self, TWR_TICK_INFINITY);
+}
+
+/*
+This function will add the work to the queue and plan the task after the delay, every push plans it again
+*/
+bool work_queue_push(work_queue_t *self, work_queue_handler_t handler, void *param)
+{
+    for (int i = 0; i < self->count; i++)
+    {
+        work_queue_item_t *item = &self->items[(self->head + i) % WORK_QUEUE_CAPACITY];
+
+        if (item->handler == handler && item->param == param)
+        {
+            self->merged++;
+
+            twr_scheduler_plan_relative(self->task_id, self->delay);
+
+            return true;
+        }
+    }
+
+    if (self->count == WORK_QUEUE_CAPACITY)
+    {
+        self->dropped++;
+
+        twr_log_warning("Work queue full");
+
+        return false;
+    }
+
+    self->items[(self->head + self->count) % WORK_QUEUE_CAPACITY] = (work_queue_item_t) { handler, param };
+    self->count++;
+
+    twr_scheduler_plan_relative(self->task_id, self->delay);
+
+    return true;
+}
+
+/*
+Task running the work that was in the queue when it started, work pushed by the work itself waits for the next run
+*/
+static void work_queue_task(void *param)
+{
+    work_queue_t *self = param;
+    int count = self->count;
+
+    while (count-- > 0)
+    {
+        work_queue_item_t item = self->items[self->head];
+
+        self->head = (self->head + 1) % WORK_QUEUE_CAPACITY;
+        self->count--;
+
+        item.handler(item.param);
+        self->done++;
+    }
+
+    twr_log_debug("$WORK: %lu done, %lu merged, %lu dropped", (unsigned long) self->done, (unsigned long) self->merged, (unsigned long) self->dropped);
+}